@@ -1,7 +1,9 @@
 #include "actions.h"
 #include "bindings.h"
 #include "problems.h"
+#include <algorithm>
 #include <stack>
+#include <stdexcept>
 
 // =================== Action ======================
 
@@ -10,13 +12,16 @@ size_t Action::next_id = 0;
 
 // Construct an action with the given name.
 Action::Action(const string& name, bool durative)
-	:id(next_id++), name(name), condition(&Formula::TRUE_FORMULA),
+	:id(next_id++), name(name), pseudo(!name.empty() && name[0] == '<'),
+	condition(&Formula::TRUE_FORMULA),
 	durative(durative), min_duration(new Value(0.0f)),
 	max_duration(new Value(durative ?
 		numeric_limits<float>::infinity() : 0.0f)) {
 	Formula::register_use(this->condition);
 	RCObject::ref(this->min_duration);
 	RCObject::ref(this->max_duration);
+	min_duration_value = dynamic_cast<const Value*>(this->min_duration);
+	max_duration_value = dynamic_cast<const Value*>(this->max_duration);
 }
 
 
@@ -52,6 +57,7 @@ void Action::set_min_duration(const Expression& min_duration) {
 		RCObject::ref(&md);
 		RCObject::destructive_deref(this->min_duration);
 		this->min_duration = &md;
+		min_duration_value = dynamic_cast<const Value*>(this->min_duration);
 	}
 }
 
@@ -62,6 +68,7 @@ void Action::set_max_duration(const Expression& max_duration) {
 		RCObject::ref(&md);
 		RCObject::destructive_deref(this->max_duration);
 		this->max_duration = &md;
+		max_duration_value = dynamic_cast<const Value*>(this->max_duration);
 	}
 }
 
@@ -147,9 +154,9 @@ const GroundAction* ActionSchema::get_instantiation(const SubstitutionMap& args,
 			problem.get_init_values()));
 		ga.set_max_duration(get_max_duration().get_instantiation(args,
 			problem.get_init_values()));
-		const Value* v1 = dynamic_cast<const Value*>(&ga.get_min_duration());
+		const Value* v1 = ga.get_min_duration_value();
 		if (v1 != NULL) {
-			const Value* v2 = dynamic_cast<const Value*>(&ga.get_max_duration());
+			const Value* v2 = ga.get_max_duration_value();
 			if (v2 != NULL) {
 				if (v1->get_value() > v2->get_value()) {
 					delete &ga;
@@ -286,4 +293,54 @@ void GroundAction::print(ostream& os,
 		os << ' ' << *ni;
 	}
 	os << ')';
-}
\ No newline at end of file
+}
+
+
+// =================== AchieverTable ======================
+
+// Less-than comparison of achievers by action.
+struct AchieverActionLess {
+	// Check if the action of the given achiever precedes the given action.
+	bool operator()(const ActionEffect& ae, const Action* action) const {
+		return ae.first->get_id() < action->get_id();
+	}
+
+	// Check if the given action precedes the action of the given achiever.
+	bool operator()(const Action* action, const ActionEffect& ae) const {
+		return action->get_id() < ae.first->get_id();
+	}
+};
+
+// Return the achievers of this range with the given action.
+pair<AchieverRange::const_iterator, AchieverRange::const_iterator>
+AchieverRange::equal_range(const Action* action) const {
+	return std::equal_range(first, last, action, AchieverActionLess());
+}
+
+// Add the given achievers for the given key, which must be higher than any key added before.
+void AchieverTable::add(size_t key, const ActionEffectMap& achievers) {
+	if (key + 1 < offsets.size()) {
+		throw logic_error("achiever keys out of order");
+	}
+	offsets.resize(key + 1, this->achievers.size());
+	this->achievers.insert(this->achievers.end(),
+		achievers.begin(), achievers.end());
+	offsets.push_back(this->achievers.size());
+}
+
+// Remove all achievers from this table.
+void AchieverTable::clear() {
+	offsets.assign(1, 0);
+	achievers.clear();
+}
+
+// Return the achievers of the given key.
+AchieverRange AchieverTable::find(size_t key) const {
+	if (key + 1 < offsets.size()) {
+		const ActionEffect* base = achievers.data();
+		return AchieverRange(base + offsets[key], base + offsets[key + 1]);
+	}
+	else {
+		return AchieverRange(NULL, NULL);
+	}
+}
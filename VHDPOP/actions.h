@@ -2,6 +2,7 @@
 #include "effects.h"
 
 class Expression;
+class Value;
 class Domain;
 class Bindings;
 
@@ -18,6 +19,8 @@ class Action {
 	size_t id;
 	// Name of this action.
 	string name;
+	// Whether this is a pseudo action, with a name starting with '<'.
+	bool pseudo;
 	// Action condition.
 	const Formula* condition;
 	// List of action effects.
@@ -28,6 +31,10 @@ class Action {
 	const Expression* min_duration;
 	// Maximum duration of this action.
 	const Expression* max_duration;
+	// Minimum duration of this action if it is constant, or NULL.
+	const Value* min_duration_value;
+	// Maximum duration of this action if it is constant, or NULL.
+	const Value* max_duration_value;
 
 protected:
 	// Construct an action with the given name.
@@ -58,6 +65,9 @@ public:
 	// Return the name of this action.
 	const string& get_name() const { return name; }
 
+	// Check if this is a pseudo action (such as the initial-state or goal action), which is never added as a new step.
+	bool is_pseudo() const { return pseudo; }
+
 	// Return the condition of this action.
 	const Formula& get_condition() const { return *condition; }
 
@@ -73,6 +83,12 @@ public:
 	// Maximum duration of this action.
 	const Expression& get_max_duration() const { return *max_duration; }
 
+	// Return the minimum duration of this action if it is constant, or NULL otherwise.
+	const Value* get_min_duration_value() const { return min_duration_value; }
+
+	// Return the maximum duration of this action if it is constant, or NULL otherwise.
+	const Value* get_max_duration_value() const { return max_duration_value; }
+
 	// "Strengthen" the effects of this action.
 	void strengthen_effects(const Domain& domain);
 
@@ -213,6 +229,66 @@ class ActionEffectMap :public multimap<const Action*, const Effect*> {
 };
 
 
+// =================== AchieverTable ======================
+
+// An action together with one of its effects.
+typedef pair<const Action*, const Effect*> ActionEffect;
+
+// A range of achievers in an achiever table, ordered by action.
+class AchieverRange {
+	// First achiever of this range.
+	const ActionEffect* first;
+	// End of this range.
+	const ActionEffect* last;
+
+public:
+	// Iterator over the achievers of a range.
+	typedef const ActionEffect* const_iterator;
+
+	// Construct a range of achievers.
+	AchieverRange(const ActionEffect* first, const ActionEffect* last)
+		:first(first), last(last) {}
+
+	// Return an iterator to the first achiever of this range.
+	const_iterator begin() const { return first; }
+
+	// Return an iterator to the end of this range.
+	const_iterator end() const { return last; }
+
+	// Check if this range is empty.
+	bool empty() const { return first == last; }
+
+	// Return the achievers of this range with the given action.
+	pair<const_iterator, const_iterator> equal_range(const Action* action) const;
+};
+
+// A table of achievers for keys numbered from zero.  The achievers of all
+// keys are stored in a single array, with the achievers of a key forming a
+// contiguous range given by an offset array, so that a lookup is two loads.
+class AchieverTable {
+	// Offset of the first achiever of each key, followed by the number of achievers.
+	vector<size_t> offsets;
+	// Achievers of all keys, by key and then by action.
+	vector<ActionEffect> achievers;
+
+public:
+	// Construct an empty achiever table.
+	AchieverTable() :offsets(1, 0) {}
+
+	// Add the given achievers for the given key, which must be higher than any key added before.
+	void add(size_t key, const ActionEffectMap& achievers);
+
+	// Remove all achievers from this table.
+	void clear();
+
+	// Return the achievers of the given key.
+	AchieverRange find(size_t key) const;
+
+	// Return the achievers of all keys.
+	const vector<ActionEffect>& get_achievers() const { return achievers; }
+};
+
+
 
 // =================== GroundActionSet ======================
 
@@ -5,19 +5,145 @@
 #include "problems.h"
 #include "formulas.h"
 #include <algorithm>
+#include <atomic>
 #include <iterator>
+#include <mutex>
 #include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+// Lock for the cached projection sets of action domains.
+static mutex projection_lock;
+
+// Serial number of the next binding collection to be created.
+static atomic<size_t> next_bindings_serial(1);
+
+// =================== BindingList ======================
+
+// Construct a copy of the given binding list.
+BindingList::BindingList(const BindingList& bl)
+	:bindings(reinterpret_cast<Binding*>(inline_bindings)),
+	count(0), capacity(INLINE_SIZE) {
+	*this = bl;
+}
+
+// Destruct this binding list.
+BindingList::~BindingList() {
+	while (count > 0) {
+		pop_back();
+	}
+	if (capacity > INLINE_SIZE) {
+		::operator delete(bindings);
+	}
+}
+
+// Assign a copy of the given binding list to this list.
+BindingList& BindingList::operator=(const BindingList& bl) {
+	if (this != &bl) {
+		while (count > 0) {
+			pop_back();
+		}
+		reserve(bl.count);
+		for (const_iterator bi = bl.begin(); bi != bl.end(); bi++) {
+			push_back(*bi);
+		}
+	}
+	return *this;
+}
+
+// Make room for at least the given number of bindings.
+void BindingList::reserve(size_t n) {
+	if (n > capacity) {
+		Binding* new_bindings =
+			static_cast<Binding*>(::operator new(n * sizeof(Binding)));
+		for (size_t i = 0; i < count; i++) {
+			new (new_bindings + i) Binding(bindings[i]);
+			bindings[i].~Binding();
+		}
+		if (capacity > INLINE_SIZE) {
+			::operator delete(bindings);
+		}
+		bindings = new_bindings;
+		capacity = n;
+	}
+}
+
+// =================== TupleTable ======================
+
+// Return the number of bits set in the given word.
+static size_t count_bits(unsigned long long word) {
+#ifdef _MSC_VER
+	return size_t(__popcnt64(word));
+#else
+	return size_t(__builtin_popcountll(word));
+#endif
+}
+
+// Set the given bit in the given bitmap, extending the bitmap as needed.
+static void set_bit(TupleBits& bits, size_t i) {
+	if (bits.size() <= i / 64) {
+		bits.resize(i / 64 + 1, 0);
+	}
+	bits[i / 64] |= 1ULL << (i % 64);
+}
+
+// Add a tuple to this table.
+void TupleTable::add(const ObjectList& tuple) {
+	size_t row = tuples.size();
+	tuples.push_back(&tuple);
+	if (postings.size() < tuple.size()) {
+		postings.resize(tuple.size());
+	}
+	for (size_t c = 0; c < tuple.size(); c++) {
+		size_t o = size_t(Term(tuple[c]).get_index());
+		if (postings[c].size() <= o) {
+			postings[c].resize(o + 1);
+		}
+		set_bit(postings[c][o], row);
+	}
+}
+
+// Return the posting bitmaps of the given column, indexed by object index.
+const vector<TupleBits>& TupleTable::get_postings(size_t column) const {
+	if (column >= postings.size()) {
+		throw logic_error("Column exceeds the range!");
+	}
+	return postings[column];
+}
+
+// Return the posting bitmap of the given object in the given column.
+const TupleBits& TupleTable::get_posting(size_t column, const Object& obj) const {
+	static const TupleBits NONE;
+	const vector<TupleBits>& column_postings = get_postings(column);
+	size_t o = size_t(Term(obj).get_index());
+	return (o < column_postings.size()) ? column_postings[o] : NONE;
+}
+
 
 // =================== ActionDomain ======================
 
 // Construct an action domain with a single tuple.
-ActionDomain::ActionDomain(const ObjectList& tuple) {
+ActionDomain::ActionDomain(const ObjectList& tuple)
+	:table(new TupleTable()), num_tuples(0) {
 #ifdef DEBUG_MEMORY
 	++created_action_domains;
 #endif // DEBUG_MEMORY
+	ref(table);
 	add(tuple);
 }
 
+// Construct an action domain with the given tuples of the given table.
+ActionDomain::ActionDomain(TupleTable* table, TupleBits& rows, size_t num_tuples)
+	:table(table), num_tuples(num_tuples) {
+#ifdef DEBUG_MEMORY
+	++created_action_domains;
+#endif // DEBUG_MEMORY
+	ref(table);
+	this->rows.swap(rows);
+}
+
 // Destruct this action domain.
 ActionDomain::~ActionDomain() {
 #ifdef DEBUG_MEMORY
@@ -27,29 +153,67 @@ ActionDomain::~ActionDomain() {
 		pi != projections.end(); pi++) {
 		delete (*pi).second;
 	}
+	destructive_deref(table);
 }
 
-// Add a tuple to this action domain.
+// Add a tuple to this action domain, which must not have been restricted from another domain or read yet.
 void ActionDomain::add(const ObjectList& tuple) {
-	tuples.push_back(&tuple);
+	set_bit(rows, table->get_tuples().size());
+	table->add(tuple);
+	num_tuples++;
+}
+
+// Compute the objects of every column of this domain.
+void ActionDomain::find_column_objects() const {
+	column_objects.resize(table->get_num_columns());
+	for (size_t c = 0; c < column_objects.size(); c++) {
+		const vector<TupleBits>& postings = table->get_postings(c);
+		TupleBits& bits = column_objects[c];
+		bits.resize(postings.size() / 64 + 1, 0);
+		for (size_t o = 0; o < postings.size(); o++) {
+			const TupleBits& posting = postings[o];
+			for (size_t w = 0; w < posting.size() && w < rows.size(); w++) {
+				if ((posting[w] & rows[w]) != 0) {
+					set_bit(bits, o);
+					break;
+				}
+			}
+		}
+	}
+}
+
+// Return the objects of the given column.
+const TupleBits& ActionDomain::object_bits(size_t column) const {
+	// Check the column before any objects are computed.
+	table->get_postings(column);
+	// The objects are computed once, so reads after that need no lock.
+	call_once(objects_once, &ActionDomain::find_column_objects, this);
+	return column_objects[column];
+}
+
+// Check if the given column of this domain includes the given object.
+bool ActionDomain::includes(const Object& obj, size_t column) const {
+	const TupleBits& bits = object_bits(column);
+	size_t o = size_t(Term(obj).get_index());
+	return o / 64 < bits.size() && ((bits[o / 64] >> (o % 64)) & 1) != 0;
 }
 
 // Return the set of objects from the given column. ??? what is column
 const ObjectSet& ActionDomain::get_projection(size_t column) const {
+	lock_guard<mutex> lock(projection_lock);
 	ProjectionMap::const_iterator pi = projections.find(column);
 	if (pi != projections.end()) {
 		return *(*pi).second;
 	}
 	else {
 		ObjectSet* projection = new ObjectSet();
-		for (TupleList::const_iterator ti = get_tuples().begin();
-			ti != get_tuples().end(); ++ti) {
-			const ObjectList& tuple = **ti;
-			// should pay attention to the tuple index???
-			if (column >= tuple.size()) {
-				throw logic_error("Column exceeds the range!");
+		const TupleBits& bits = object_bits(column);
+		for (size_t w = 0; w < bits.size(); w++) {
+			for (size_t b = 0; b < 64; b++) {
+				if (((bits[w] >> b) & 1) != 0) {
+					projection->insert(Object(int(w * 64 + b)));
+				}
 			}
-			projection->insert(tuple[column]);
 		}
 		projections.insert(make_pair(column, projection));
 		return *projection;
@@ -58,133 +222,82 @@ const ObjectSet& ActionDomain::get_projection(size_t column) const {
 
 // Return the size of the projection of the given column.
 const size_t ActionDomain::projection_size(size_t column) const {
-	return get_projection(column).size();
+	const TupleBits& bits = object_bits(column);
+	size_t n = 0;
+	for (size_t w = 0; w < bits.size(); w++) {
+		n += count_bits(bits[w]);
+	}
+	return n;
 }
 
-// Return a domain where the given column has been restricted to the given object, or 0 if this would leave an empty domain.
-const ActionDomain* ActionDomain::get_restricted_domain(const Object& obj, size_t column) const {
-	ActionDomain* new_domain = 0;
-	for (TupleList::const_iterator ti = get_tuples().begin();
-		ti != get_tuples().end(); ++ti) {
-		const ObjectList& tuple = **ti;
-		if (column >= tuple.size()) {
-			throw logic_error("Column exceeds the range!");
-		}
-		if (tuple[column] == obj) {
-			if (new_domain == 0) {
-				new_domain = new ActionDomain(tuple);
-			}
-			else {
-				new_domain->add(tuple);
-			}
-		}
+// Return a domain with the tuples of this domain that are (or with exclude, are not) in the given set, or 0 if this would leave an empty domain.
+const ActionDomain* ActionDomain::select(const TupleBits& selection,
+	bool exclude) const {
+	TupleBits new_rows(rows.size(), 0);
+	size_t n = 0;
+	for (size_t w = 0; w < rows.size(); w++) {
+		unsigned long long s = (w < selection.size()) ? selection[w] : 0;
+		new_rows[w] = rows[w] & (exclude ? ~s : s);
+		n += count_bits(new_rows[w]);
+	}
+	if (n == 0) {
+		return 0;
 	}
-	if (new_domain != 0 && new_domain->size() == size()) {
-		// For storage efficiency???
-		ActionDomain::register_use(new_domain);
-		ActionDomain::unregister_use(new_domain);
+	else if (n == size()) {
 		return this;
 	}
 	else {
-		return new_domain;
+		return new ActionDomain(table, new_rows, n);
 	}
 }
 
-// Return a domain where the given column has been restricted to the given set of objects, or 0 if this would leave an empty domain.
-const ActionDomain* ActionDomain::get_restricted_domain(const ObjectSet& objs, size_t column) const {
-	ActionDomain* new_domain = 0;
-	for (TupleList::const_iterator ti = get_tuples().begin();
-		ti != get_tuples().end(); ti++) {
-		const ObjectList& tuple = **ti;
-		if (column >= tuple.size()) {
-			throw logic_error("Column exceeds the range!");
+// Return the tuples with one of the given objects in the given column.
+TupleBits ActionDomain::postings_of(const ObjectSet& objs, size_t column) const {
+	TupleBits selection(rows.size(), 0);
+	for (ObjectSet::const_iterator oi = objs.begin(); oi != objs.end(); oi++) {
+		const TupleBits& posting = table->get_posting(column, *oi);
+		for (size_t w = 0; w < posting.size() && w < selection.size(); w++) {
+			selection[w] |= posting[w];
 		}
-		if (objs.find(tuple[column]) != objs.end()) {
-			if (new_domain == 0) {
-				new_domain = new ActionDomain(tuple);
-			}
-			else {
-				new_domain->add(tuple);
-			}
-		}
-	}
-	if (new_domain != 0 && new_domain->size() == size()) {
-		ActionDomain::register_use(new_domain);
-		ActionDomain::unregister_use(new_domain);
-		return this;
-	}
-	else {
-		return new_domain;
 	}
+	return selection;
+}
+
+// Return a domain where the given column has been restricted to the given object, or 0 if this would leave an empty domain.
+const ActionDomain* ActionDomain::get_restricted_domain(const Object& obj, size_t column) const {
+	return select(table->get_posting(column, obj), false);
+}
+
+// Return a domain where the given column has been restricted to the given set of objects, or 0 if this would leave an empty domain.
+const ActionDomain* ActionDomain::get_restricted_domain(const ObjectSet& objs, size_t column) const {
+	return select(postings_of(objs, column), false);
 }
 
 // Return a domain where the given column excludes the given object, or 0 if this would leave an empty domain.
 const ActionDomain* ActionDomain::get_excluded_domain(const Object& obj, size_t column) const {
-	ActionDomain* new_domain = 0;
-	for (TupleList::const_iterator ti = get_tuples().begin();
-		ti != get_tuples().end(); ++ti) {
-		const ObjectList& tuple = **ti;
-		if (column >= tuple.size()) {
-			throw logic_error("Column exceeds the range!");
-		}
-		if (tuple[column] != obj) {
-			if (new_domain == 0) {
-				new_domain = new ActionDomain(tuple);
-			}
-			else {
-				new_domain->add(tuple);
-			}
-		}
-	}
-	if (new_domain != 0 && new_domain->size() == size()) {
-		// For storage efficiency???
-		ActionDomain::register_use(new_domain);
-		ActionDomain::unregister_use(new_domain);
-		return this;
-	}
-	else {
-		return new_domain;
-	}
+	return select(table->get_posting(column, obj), true);
 }
 
 // Return a domain where the given column excludes the given set of objects, or 0 if this would leave an empty domain.
 const ActionDomain* ActionDomain::get_excluded_domain(const ObjectSet& objs, size_t column) const {
-	ActionDomain* new_domain = 0;
-	for (TupleList::const_iterator ti = get_tuples().begin();
-		ti != get_tuples().end(); ti++) {
-		const ObjectList& tuple = **ti;
-		if (column >= tuple.size()) {
-			throw logic_error("Column exceeds the range!");
-		}
-		if (objs.find(tuple[column]) == objs.end()) {
-			if (new_domain == 0) {
-				new_domain = new ActionDomain(tuple);
-			}
-			else {
-				new_domain->add(tuple);
-			}
-		}
-	}
-	if (new_domain != 0 && new_domain->size() == size()) {
-		ActionDomain::register_use(new_domain);
-		ActionDomain::unregister_use(new_domain);
-		return this;
-	}
-	else {
-		return new_domain;
-	}
+	return select(postings_of(objs, column), true);
 }
 
 // Print this action domain on the given stream.
 void ActionDomain::print(ostream& os) const {
 	os << '{';
-	for (TupleList::const_iterator ti = get_tuples().begin();
-		ti != get_tuples().end(); ti++) {
-		if (ti != get_tuples().begin()) {
+	bool first = true;
+	const TupleList& tuples = table->get_tuples();
+	for (size_t t = 0; t < tuples.size(); t++) {
+		if (((rows[t / 64] >> (t % 64)) & 1) == 0) {
+			continue;
+		}
+		if (!first) {
 			os << ' ';
 		}
+		first = false;
 		os << '<';
-		const ObjectList& tuple = **ti;
+		const ObjectList& tuple = *tuples[t];
 		for (ObjectList::const_iterator ni = tuple.begin();
 			ni != tuple.end(); ni++) {
 			if (ni != tuple.begin()) {
@@ -209,13 +322,7 @@ int StepDomain::index_of(const Variable& var) const {
 
 // Check if this step domain includes the given object in the given column.
 bool StepDomain::includes(const Object& obj, size_t column) const {
-	for (TupleList::const_iterator ti = get_domain().get_tuples().begin();
-		ti != get_domain().get_tuples().end(); ti++) {
-		if ((**ti)[column] == obj) {
-			return true;
-		}
-	}
-	return false;
+	return get_domain().includes(obj, column);
 }
 
 // Return the set of objects from the given column.
@@ -572,38 +679,107 @@ const VarSet* VarSet::make(const Chain<VarSet>*& vsc, const Binding& b,
 	}
 }
 
-// Return the varset containing the given object, or 0 if none do.
-static const VarSet* find_varset(const Chain<VarSet>* varsets,
-	const Object& obj) {
-	for (const Chain<VarSet>* vsc = varsets; vsc != 0; vsc = vsc->get_tail()) {
-		const VarSet& vs = vsc->get_head();
-		if (vs.includes(obj)) {
-			return &vs;
+// =================== VarSetIndex ======================
+
+// Return the index key of the given object.
+static VarSetKey varset_key(const Object& obj) {
+	return VarSetKey(Term(obj).get_index(), 0);
+}
+
+// Return the index key of the given variable with the given step id.
+static VarSetKey varset_key(const Variable& var, size_t step_id) {
+	return VarSetKey(Term(var).get_index(), step_id);
+}
+
+// Construct an index layer on top of the given index.
+VarSetIndex::VarSetIndex(const VarSetIndex* base)
+	:base(base), layers((base != 0) ? base->layers + 1 : 1) {
+	ref(base);
+}
+
+// Destruct this index layer.
+VarSetIndex::~VarSetIndex() {
+	destructive_deref(base);
+}
+
+// Add the terms of the given varset, unless an earlier varset of this layer includes them.
+void VarSetIndex::add(const VarSet& vs) {
+	if (vs.get_constant() != 0) {
+		varsets.insert(make_pair(varset_key(*vs.get_constant()), &vs));
+	}
+	for (const Chain<StepVariable>* vc = vs.get_cd_set();
+		vc != 0; vc = vc->get_tail()) {
+		varsets.insert(make_pair(varset_key(vc->get_head().first,
+			vc->get_head().second), &vs));
+	}
+}
+
+// Return an index for the given chain of varsets, which consists of new varsets on top of the chain indexed by the given base index.
+const VarSetIndex* VarSetIndex::make(const VarSetIndex* base,
+	const Chain<VarSet>* varsets, const Chain<VarSet>* base_varsets) {
+	if (varsets == base_varsets) {
+		return base;
+	}
+	bool merge = (base != 0 && base->layers >= MAX_LAYERS);
+	VarSetIndex* index = new VarSetIndex(merge ? 0 : base);
+	for (const Chain<VarSet>* vsc = varsets; vsc != base_varsets;
+		vsc = vsc->get_tail()) {
+		index->add(vsc->get_head());
+	}
+	if (merge) {
+		// Merge all layers into one, keeping the entries of the newest layers.
+		for (const VarSetIndex* layer = base; layer != 0; layer = layer->base) {
+			index->varsets.insert(layer->varsets.begin(), layer->varsets.end());
+		}
+	}
+	return index;
+}
+
+// Return the first varset including the term with the given key, or 0 if none do.
+const VarSet* VarSetIndex::find(const VarSetKey& key) const {
+	for (const VarSetIndex* layer = this; layer != 0; layer = layer->base) {
+		KeyMap::const_iterator vi = layer->varsets.find(key);
+		if (vi != layer->varsets.end()) {
+			return (*vi).second;
 		}
 	}
 	return 0;
 }
 
-// Return the varset containing the given variable, or 0 if none do.
+// Return the varset including the term with the given key, or 0 if none do; the varsets above base_varsets are searched first, and the rest through the index of base_varsets.
 static const VarSet* find_varset(const Chain<VarSet>* varsets,
-	const Variable& var, size_t step_id) {
-	for (const Chain<VarSet>* vsc = varsets; vsc != 0; vsc = vsc->get_tail()) {
+	const Chain<VarSet>* base_varsets, const VarSetIndex* index,
+	const VarSetKey& key) {
+	for (const Chain<VarSet>* vsc = varsets; vsc != base_varsets;
+		vsc = vsc->get_tail()) {
 		const VarSet& vs = vsc->get_head();
-		if (vs.includes(var, step_id)) {
+		if ((key.first >= 0) ? vs.includes(Object(key.first))
+			: vs.includes(Variable(key.first), key.second)) {
 			return &vs;
 		}
 	}
-	return 0;
+	return (index != 0) ? index->find(key) : 0;
+}
+
+// Return the varset containing the given object, or 0 if none do.
+static const VarSet* find_varset(const VarSetIndex* index, const Object& obj) {
+	return (index != 0) ? index->find(varset_key(obj)) : 0;
+}
+
+// Return the varset containing the given variable, or 0 if none do.
+static const VarSet* find_varset(const VarSetIndex* index,
+	const Variable& var, size_t step_id) {
+	return (index != 0) ? index->find(varset_key(var, step_id)) : 0;
 }
 
 // Return the varset containing the given term, or 0 if none do.
-static const VarSet* find_varset(const Chain<VarSet>* varsets,
+static const VarSet* find_varset(const VarSetIndex* index,
 	const Term& term, size_t step_id) {
 	if (term.is_object()) {
-		return find_varset(varsets, term.as_object());
+		return find_varset(index, term.as_object());
 	}
 	else {
-		return find_varset(varsets, term.as_variable(), step_id);
+		return find_varset(index, term.as_variable(), step_id);
 	}
 }
 
@@ -612,22 +788,27 @@ static const VarSet* find_varset(const Chain<VarSet>* varsets,
 // =================== Bindings ======================
 
 // Empty bindings.
-const Bindings Bindings::EMPTY = Bindings();
+const Bindings Bindings::EMPTY;
 
 // Construct a binding collection, empty by default.
 Bindings::Bindings()
-	:varsets(0), high_step_id(0), step_domains(0) {
+	:varsets(0), index(0), high_step_id(0), step_domains(0),
+	serial(next_bindings_serial++) {
 	ref(this); //??? why
 }
 
-// Construct a binding collection.
+// Construct a binding collection refining the given binding collection.
 Bindings::Bindings(const Chain<VarSet>* varsets, size_t high_step_id,
-	const Chain<StepDomain>* step_domains)
-	: varsets(varsets), high_step_id(high_step_id), step_domains(step_domains) {
+	const Chain<StepDomain>* step_domains, const Bindings& parent)
+	: varsets(varsets),
+	index(VarSetIndex::make(parent.index, varsets, parent.varsets)),
+	high_step_id(high_step_id), step_domains(step_domains),
+	serial(next_bindings_serial++) {
 #ifdef DEBUG_MEMORY
 	created_bindings++;
 #endif //DEBUG_MEMORY
 	RCObject::ref(varsets); //???
+	RCObject::ref(index);
 	RCObject::ref(step_domains);
 }
 
@@ -637,7 +818,17 @@ Bindings::~Bindings() {
 	++deleted_bindings;
 #endif // DEBUG_MEMORY
 	RCObject::destructive_deref(varsets);
+	RCObject::destructive_deref(index);
 	RCObject::destructive_deref(step_domains);
+	for (map<VarSetKey, const ObjectSet*>::const_iterator di = domains.begin();
+		di != domains.end(); di++) {
+		delete (*di).second;
+	}
+	for (unordered_map<AffectsKey, bool, AffectsKeyHash>::const_iterator ai =
+		affects_cache.begin(); ai != affects_cache.end(); ai++) {
+		Formula::unregister_use((*ai).first.l1);
+		Formula::unregister_use((*ai).first.l2);
+	}
 }
 
 // Check if the given formulas (literals) can be unified.
@@ -659,7 +850,7 @@ Term Bindings::get_binding(const Term& term, size_t step_id) const {
 	if (term.is_variable()) {
 		const VarSet* vs =
 			((step_id <= high_step_id)
-				? find_varset(varsets, term.as_variable(), step_id) : 0);
+				? find_varset(index, term.as_variable(), step_id) : 0);
 		if (vs != 0 && vs->get_constant() != 0) {
 			return *vs->get_constant();
 		}
@@ -676,23 +867,30 @@ const ObjectSet& Bindings::get_domain(const Variable& var, size_t step_id,
 		return sd.first->get_projection(sd.second);
 	}
 	else {
-		const ObjectList& objects =
-			problem.get_terms().compatible_objects(TermTable::type(var));
-		ObjectSet* objs = new ObjectSet();
-		objs->insert(objects.begin(), objects.end());
+		const ObjectSet& objects =
+			problem.get_terms().compatible_object_set(TermTable::type(var));
 		const VarSet* vs =
-			(step_id <= high_step_id) ? find_varset(varsets, var, step_id) : 0;
-		if (vs != 0) {
-			for (const Chain<StepVariable>* vc = vs->get_ncd_set();
-				vc != 0; vc = vc->get_tail()) {
-				const StepVariable& sv = vc->get_head();
-				const VarSet* vs2 = ((sv.second <= high_step_id)
-					? find_varset(varsets, sv.first, sv.second) : 0);
-				if (vs2 != 0 && vs2->get_constant() != 0) {
-					objs->erase(*vs2->get_constant());
-				}
+			(step_id <= high_step_id) ? find_varset(index, var, step_id) : 0;
+		if (vs == 0 || vs->get_ncd_set() == 0) {
+			return objects;
+		}
+		lock_guard<mutex> lock(domain_lock);
+		VarSetKey key = varset_key(var, step_id);
+		map<VarSetKey, const ObjectSet*>::const_iterator di = domains.find(key);
+		if (di != domains.end()) {
+			return *(*di).second;
+		}
+		ObjectSet* objs = new ObjectSet(objects);
+		for (const Chain<StepVariable>* vc = vs->get_ncd_set();
+			vc != 0; vc = vc->get_tail()) {
+			const StepVariable& sv = vc->get_head();
+			const VarSet* vs2 = ((sv.second <= high_step_id)
+				? find_varset(index, sv.first, sv.second) : 0);
+			if (vs2 != 0 && vs2->get_constant() != 0) {
+				objs->erase(*vs2->get_constant());
 			}
 		}
+		domains.insert(make_pair(key, objs));
 		return *objs;
 	}
 }
@@ -701,20 +899,39 @@ const ObjectSet& Bindings::get_domain(const Variable& var, size_t step_id,
 bool Bindings::affects(const Literal& l1, size_t id1,
 	const Literal& l2, size_t id2) const {
 	BindingList dummy;
-	return affects(dummy, l1, id1, l2, id2);
+	// Ground literals are decided without bindings, and the empty bindings
+	// are shared by every plan of a run, so neither is worth caching.
+	if (this == &EMPTY || (l1.get_id() != 0 && l2.get_id() != 0)) {
+		return affects(dummy, l1, id1, l2, id2);
+	}
+	// Threat detection asks the same question for every plan sharing these bindings.
+	AffectsKey key(&l1, id1, &l2, id2);
+	{
+		lock_guard<mutex> lock(affects_lock);
+		unordered_map<AffectsKey, bool, AffectsKeyHash>::const_iterator ai =
+			affects_cache.find(key);
+		if (ai != affects_cache.end()) {
+			return (*ai).second;
+		}
+	}
+	bool result = affects(dummy, l1, id1, l2, id2);
+	lock_guard<mutex> lock(affects_lock);
+	if (affects_cache.insert(make_pair(key, result)).second) {
+		Formula::register_use(&l1);
+		Formula::register_use(&l2);
+	}
+	return result;
 }
 
 // Check if one of the given formulas is the negation of the other, and the atomic formulas can be unified; the most general unifier is added to the provided substitution list.
 bool Bindings::affects(BindingList& mgu, const Literal& l1, size_t id1,
 	const Literal& l2, size_t id2) const {
-	const Negation* negation = dynamic_cast<const Negation*>(&l1);
-	if (negation != 0) {
-		return unify(mgu, l2, id2, negation->get_atom(), id1);
+	if (l1.get_kind() == NEGATION_F) {
+		return unify(mgu, l2, id2, l1.get_atom(), id1);
 	}
 	else {
-		negation = dynamic_cast<const Negation*>(&l2);
-		if (negation != 0) {
-			return unify(mgu, negation->get_atom(), id2, l1, id1);
+		if (l2.get_kind() == NEGATION_F) {
+			return unify(mgu, l2.get_atom(), id2, l1, id1);
 		}
 		else {
 			return false;
@@ -722,6 +939,19 @@ bool Bindings::affects(BindingList& mgu, const Literal& l1, size_t id1,
 	}
 }
 
+// Check if the given atoms have different objects at a position where both
+// have an object, which rules out unification under any bindings.
+static bool objects_clash(const Atom& a1, const Atom& a2) {
+	unsigned long long common = a1.get_object_positions() & a2.get_object_positions();
+	for (size_t i = 0; common != 0; i++, common >>= 1) {
+		if ((common & 1) != 0
+			&& a1.get_term(i).get_index() != a2.get_term(i).get_index()) {
+			return true;
+		}
+	}
+	return false;
+}
+
 // Check if the given formulas can be unified.
 bool Bindings::unify(const Literal& l1, size_t id1,
 	const Literal& l2, size_t id2) const {
@@ -736,7 +966,7 @@ bool Bindings::unify(BindingList& mgu, const Literal& l1, size_t id1,
 		// Both literals are fully instantiated. 
 		return &l1 == &l2;
 	}
-	else if (typeid(l1) != typeid(l2)) {
+	else if (l1.get_kind() != l2.get_kind()) {
 		// Not the same type of literal. 
 		return false;
 	}
@@ -744,6 +974,10 @@ bool Bindings::unify(BindingList& mgu, const Literal& l1, size_t id1,
 		// The predicates do not match. 
 		return false;
 	}
+	else if (objects_clash(l1.get_atom(), l2.get_atom())) {
+		// The literals have different objects in the same position. 
+		return false;
+	}
 	else if (l1.get_id() > 0 || l2.get_id() > 0) {
 		// One of the literals is fully instantiated and the other not. 
 		const Literal* ll;
@@ -861,7 +1095,7 @@ bool Bindings::is_consistent_with(const Equality& eq, size_t step_id) const {
 	size_t var_id = eq.step_id1(step_id);
 	size_t term_id = eq.step_id2(step_id);
 	const VarSet* vs =
-		(term_id <= high_step_id) ? find_varset(varsets, eq.get_term(), term_id) : 0;
+		(term_id <= high_step_id) ? find_varset(index, eq.get_term(), term_id) : 0;
 	if (vs == 0 || vs->includes(eq.get_variable(), var_id)) {
 		return true;
 	}
@@ -883,7 +1117,7 @@ bool Bindings::is_consistent_with(const Inequality& neq, size_t step_id) const {
 	size_t var_id = neq.step_id1(step_id);
 	size_t term_id = neq.step_id2(step_id);
 	const VarSet* vs =
-		(term_id <= high_step_id) ? find_varset(varsets, neq.get_term(), term_id) : 0;
+		(term_id <= high_step_id) ? find_varset(index, neq.get_term(), term_id) : 0;
 	return (vs == 0
 		|| !vs->includes(neq.get_variable(), var_id)
 		|| vs->excludes(neq.get_variable(), var_id));
@@ -939,7 +1173,8 @@ const Bindings* Bindings::add(const BindingList& new_bindings,
 			StepVariable sv(bind.get_var(), bind.get_var_id());
 			if (bind.get_var_id() <= high_step_id
 				|| high_step_vars.find(sv) != high_step_vars.end()) {
-				vs1 = find_varset(varsets_new, bind.get_var(), bind.get_var_id());
+				vs1 = find_varset(varsets_new, varsets, index,
+					varset_key(bind.get_var(), bind.get_var_id()));
 			}
 			else {
 				if (bind.get_var_id() > high_step_new) {
@@ -951,13 +1186,15 @@ const Bindings* Bindings::add(const BindingList& new_bindings,
 			// Varset for term. 
 			const VarSet* vs2;
 			if (bind.get_term().is_object()) {
-				vs2 = find_varset(varsets_new, bind.get_term().as_object());
+				vs2 = find_varset(varsets_new, varsets, index,
+					varset_key(bind.get_term().as_object()));
 			}
 			else {
 				StepVariable sv(bind.get_term().as_variable(), bind.get_term_id());
 				if (bind.get_term_id() <= high_step_id
 					|| high_step_vars.find(sv) != high_step_vars.end()) {
-					vs2 = find_varset(varsets_new, sv.first, bind.get_term_id());
+					vs2 = find_varset(varsets_new, varsets, index,
+						varset_key(sv.first, bind.get_term_id()));
 				}
 				else {
 					if (bind.get_term_id() > high_step_new) {
@@ -1153,7 +1390,7 @@ const Bindings* Bindings::add(const BindingList& new_bindings,
 			StepVariable sv(bind.get_var(), bind.get_var_id());
 			if (bind.get_var_id() <= high_step_id
 				|| high_step_vars.find(sv) != high_step_vars.end()) {
-				vs1 = find_varset(varsets, bind.get_var(), bind.get_var_id());
+				vs1 = find_varset(index, bind.get_var(), bind.get_var_id());
 			}
 			else {
 				if (bind.get_var_id() > high_step_new) {
@@ -1165,13 +1402,13 @@ const Bindings* Bindings::add(const BindingList& new_bindings,
 			// Varset for term. 
 			const VarSet* vs2;
 			if (bind.get_term().is_object()) {
-				vs2 = find_varset(varsets, bind.get_term().as_object());
+				vs2 = find_varset(index, bind.get_term().as_object());
 			}
 			else {
 				StepVariable sv(bind.get_term().as_variable(), bind.get_term_id());
 				if (bind.get_term_id() <= high_step_id
 					|| high_step_vars.find(sv) != high_step_vars.end()) {
-					vs2 = find_varset(varsets, sv.first, bind.get_term_id());
+					vs2 = find_varset(index, sv.first, bind.get_term_id());
 				}
 				else {
 					if (bind.get_term_id() > high_step_new) {
@@ -1297,7 +1534,7 @@ const Bindings* Bindings::add(const BindingList& new_bindings,
 		return this;
 	}
 	else {
-		return new Bindings(varsets_new, high_step_new, step_domains_new);
+		return new Bindings(varsets_new, high_step_new, step_domains_new, *this);
 	}
 }
 
@@ -1343,7 +1580,88 @@ const Bindings* Bindings::add(size_t step_id, const Action& step_action,
 		return this;
 	}
 	else {
-		return new Bindings(varsets_new, high_step_new, step_domains_new);
+		return new Bindings(varsets_new, high_step_new, step_domains_new, *this);
+	}
+}
+
+// Add the given chain of step variables to the given signature words, sorted and with step ids renumbered by the given map.
+static void add_step_variables(vector<size_t>& words,
+	const Chain<StepVariable>* svc, const map<size_t, size_t>& step_ids) {
+	vector<pair<size_t, size_t> > svs;
+	for (; svc != 0; svc = svc->tail) {
+		const StepVariable& sv = svc->head;
+		map<size_t, size_t>::const_iterator si = step_ids.find(sv.second);
+		Term var = sv.first;
+		svs.push_back(make_pair((si != step_ids.end()) ? (*si).second : sv.second,
+			size_t(var.get_index())));
+	}
+	sort(svs.begin(), svs.end());
+	words.push_back(svs.size());
+	for (vector<pair<size_t, size_t> >::const_iterator vi = svs.begin();
+		vi != svs.end(); vi++) {
+		words.push_back((*vi).first);
+		words.push_back((*vi).second);
+	}
+}
+
+// Append the current varsets and step domains to the given plan signature, with step ids renumbered by the given map.
+void Bindings::add_signature(vector<size_t>& sig,
+	const map<size_t, size_t>& step_ids) const {
+	// Older versions of a varset stay in the chain behind the newer ones,
+	// so a varset is current only if it is the first to include one of its
+	// variables or its constant.
+	vector<vector<size_t> > sets;
+	VariableSet seen_vars;
+	ObjectSet seen_objs;
+	for (const Chain<VarSet>* vsc = varsets; vsc != 0; vsc = vsc->tail) {
+		const VarSet& vs = vsc->head;
+		bool current = (vs.get_constant() != 0
+			&& seen_objs.insert(*vs.get_constant()).second);
+		for (const Chain<StepVariable>* vc = vs.get_cd_set();
+			vc != 0; vc = vc->tail) {
+			if (seen_vars.insert(vc->head).second) {
+				current = true;
+			}
+		}
+		if (current) {
+			vector<size_t> words;
+			if (vs.get_constant() != 0) {
+				Term obj = *vs.get_constant();
+				words.push_back(size_t(obj.get_index()) + 1);
+			}
+			else {
+				words.push_back(0);
+			}
+			add_step_variables(words, vs.get_cd_set(), step_ids);
+			add_step_variables(words, vs.get_ncd_set(), step_ids);
+			sets.push_back(words);
+		}
+	}
+	// The first step domain of a step in the chain is the current one.
+	set<size_t> seen_steps;
+	for (const Chain<StepDomain>* sdc = step_domains; sdc != 0; sdc = sdc->tail) {
+		const StepDomain& sd = sdc->head;
+		if (seen_steps.insert(sd.get_id()).second) {
+			map<size_t, size_t>::const_iterator si = step_ids.find(sd.get_id());
+			vector<size_t> words;
+			words.push_back(size_t(-1));
+			words.push_back((si != step_ids.end()) ? (*si).second : sd.get_id());
+			// The tuples of the domain, as its table and its rows of the table.
+			const TupleBits& rows = sd.get_domain().get_rows();
+			words.push_back(sd.get_domain().size());
+			words.push_back(size_t(&sd.get_domain().get_table()));
+			for (TupleBits::const_iterator ri = rows.begin(); ri != rows.end(); ri++) {
+				words.push_back(size_t(*ri & 0xffffffffULL));
+				words.push_back(size_t(*ri >> 32));
+			}
+			sets.push_back(words);
+		}
+	}
+	sort(sets.begin(), sets.end());
+	sig.push_back(sets.size());
+	for (vector<vector<size_t> >::const_iterator wi = sets.begin();
+		wi != sets.end(); wi++) {
+		sig.insert(sig.end(), (*wi).begin(), (*wi).end());
 	}
 }
 
@@ -3,7 +3,11 @@
 #include "terms.h"
 #include "chain.h"
 #include "formulas.h"
+#include <mutex>
+#include <new>
 #include <set>
+#include <type_traits>
+#include <unordered_map>
 
 class Literal;
 class Equality;
@@ -60,17 +64,73 @@ public:
 
 // =================== BindingList ======================
 
-// A list (vector) of bindings.
-class BindingList :public vector<Binding> {
+// A list of bindings.  The first bindings are stored inline, enough for
+// the unifier of two literals of most predicates, so that unification
+// does not allocate memory; longer lists move to the heap.
+class BindingList {
+	// Number of bindings stored inline.
+	static const size_t INLINE_SIZE = 8;
+
+	// Inline storage for bindings.
+	typename aligned_storage<sizeof(Binding), alignment_of<Binding>::value>::type
+		inline_bindings[INLINE_SIZE];
+	// The bindings, in inline storage or on the heap.
+	Binding* bindings;
+	// Number of bindings.
+	size_t count;
+	// Number of bindings there is room for.
+	size_t capacity;
+
+	// Make room for at least the given number of bindings.
+	void reserve(size_t n);
 
-};
+public:
+	// Iterator over the bindings.
+	typedef const Binding* const_iterator;
+
+	// Construct an empty binding list.
+	BindingList()
+		:bindings(reinterpret_cast<Binding*>(inline_bindings)),
+		count(0), capacity(INLINE_SIZE) {}
+
+	// Construct a copy of the given binding list.
+	BindingList(const BindingList& bl);
+
+	// Destruct this binding list.
+	~BindingList();
+
+	// Assign a copy of the given binding list to this list.
+	BindingList& operator=(const BindingList& bl);
+
+	// Check if this list is empty.
+	bool empty() const { return count == 0; }
+
+	// Return the number of bindings.
+	size_t size() const { return count; }
 
+	// Return the ith binding.
+	const Binding& operator[](size_t i) const { return bindings[i]; }
 
-// =================== ObjectSet ======================
+	// Return an iterator positioned at the first binding.
+	const_iterator begin() const { return bindings; }
 
-// A set of objects.
-class ObjectSet :public set<Object> {
+	// Return an iterator positioned after the last binding.
+	const_iterator end() const { return bindings + count; }
 
+	// Add a binding to the end of this list.
+	void push_back(const Binding& b) {
+		if (count == capacity) {
+			reserve(2 * capacity);
+		}
+		new (bindings + count) Binding(b);
+		count++;
+	}
+
+	// Remove the last binding of this list.
+	void pop_back() {
+		count--;
+		bindings[count].~Binding();
+	}
 };
 
 
@@ -81,22 +141,77 @@ class TupleList :public vector<const ObjectList*> {
 };
 
 
+// =================== TupleTable ======================
+
+// A set of tuples or objects, as a bit per tuple or object index.
+typedef vector<unsigned long long> TupleBits;
+
+// Parameter tuples of an action stored by column, shared by an action
+// domain and all domains restricted from it.  For each column and object,
+// a posting bitmap holds the tuples with that object in the column.
+class TupleTable :public RCObject {
+	// The tuples, in order of addition.
+	TupleList tuples;
+	// Posting bitmaps of each column, indexed by object index; a posting
+	// bitmap only extends to the last tuple it includes.
+	vector<vector<TupleBits> > postings;
+
+public:
+	// Add a tuple to this table.
+	void add(const ObjectList& tuple);
+
+	// Return the tuples of this table.
+	const TupleList& get_tuples() const { return tuples; }
+
+	// Return the number of columns of this table.
+	size_t get_num_columns() const { return postings.size(); }
+
+	// Return the posting bitmaps of the given column, indexed by object index.
+	const vector<TupleBits>& get_postings(size_t column) const;
+
+	// Return the posting bitmap of the given object in the given column.
+	const TupleBits& get_posting(size_t column, const Object& obj) const;
+};
+
+
 // =================== ActionDomain ======================
 
-// A domain for action parameters.
+// A domain for action parameters: a subset of the tuples of a tuple table.
 class ActionDomain :public RCObject {
 
 	// A projection map.
 	class ProjectionMap :public map<size_t, const ObjectSet*> {
 	};
 
-	// Possible parameter tuples.
-	TupleList tuples;
+	// Tuple table shared with the domains this domain was restricted from.
+	TupleTable* table;
+	// Tuples of the table in this domain.
+	TupleBits rows;
+	// Number of tuples in this domain.
+	size_t num_tuples;
+
+	// Objects of each column, as bits indexed by object index; empty until computed.
+	mutable vector<TupleBits> column_objects;
+	// Flag for computing the objects of all columns once.
+	mutable once_flag objects_once;
 
 	// Projections.
 	mutable ProjectionMap projections;
 
-	// diff here! no ref_count
+	// Construct an action domain with the given tuples of the given table.
+	ActionDomain(TupleTable* table, TupleBits& rows, size_t num_tuples);
+
+	// Compute the objects of every column of this domain.
+	void find_column_objects() const;
+
+	// Return the objects of the given column.
+	const TupleBits& object_bits(size_t column) const;
+
+	// Return a domain with the tuples of this domain that are (or with exclude, are not) in the given set, or 0 if this would leave an empty domain.
+	const ActionDomain* select(const TupleBits& selection, bool exclude) const;
+
+	// Return the tuples with one of the given objects in the given column.
+	TupleBits postings_of(const ObjectSet& objs, size_t column) const;
 
 public:
 
@@ -106,8 +221,6 @@ public:
 	// Destruct this action domain.
 	~ActionDomain();
 
-	// diff here!
-
 	// Register use of this action domain.
 	static void register_use(const ActionDomain* a) {
 		ref(a);
@@ -119,14 +232,20 @@ public:
 	}
 
 	// Return number of tuples.
-	size_t size() const { return get_tuples().size(); }
+	size_t size() const { return num_tuples; }
 
-	// Return the tuples of this action domain.
-	const TupleList& get_tuples() const { return tuples; }
+	// Return the tuple table of this action domain.
+	const TupleTable& get_table() const { return *table; }
+
+	// Return the tuples of the table in this action domain.
+	const TupleBits& get_rows() const { return rows; }
 
-	// Add a tuple to this action domain.
+	// Add a tuple to this action domain, which must not have been restricted from another domain or read yet.
 	void add(const ObjectList& tuple);
 
+	// Check if the given column of this domain includes the given object.
+	bool includes(const Object& obj, size_t column) const;
+
 	// Return the set of names from the given column. ??? what is column
 	const ObjectSet& get_projection(size_t column) const;
 
@@ -305,28 +424,122 @@ public:
 		bool reverse = false);
 };
 
+// =================== VarSetIndex ======================
+
+// Key of a term in a varset index: the term index and, for variables, the step id.
+typedef pair<int, size_t> VarSetKey;
+
+// Hash function for varset index keys.
+struct VarSetKeyHash {
+	size_t operator()(const VarSetKey& key) const {
+		return size_t(key.first) * 2654435761U ^ key.second;
+	}
+};
+
+// Index from the terms of a chain of varsets to the first varset of the
+// chain that includes them.  An index layer only holds the varsets that
+// were pushed on top of the chain of its base index, so the index of a
+// binding collection shares most of its structure with the index of the
+// collection it was refined from.  Layers are merged when there are too
+// many of them, so a lookup takes a bounded number of hash probes.
+class VarSetIndex :public RCObject {
+	// Maximum number of layers of an index.
+	static const int MAX_LAYERS = 8;
+
+	// Map from keys to varsets.
+	typedef unordered_map<VarSetKey, const VarSet*, VarSetKeyHash> KeyMap;
+
+	// Index of the varsets below the varsets of this layer, or 0.
+	const VarSetIndex* base;
+	// Varsets of this layer.
+	KeyMap varsets;
+	// Number of layers of this index.
+	int layers;
+
+	// Construct an index layer on top of the given index.
+	VarSetIndex(const VarSetIndex* base);
+
+	// Add the terms of the given varset, unless an earlier varset of this layer includes them.
+	void add(const VarSet& vs);
+
+public:
+	// Return an index for the given chain of varsets, which consists of new varsets on top of the chain indexed by the given base index.
+	static const VarSetIndex* make(const VarSetIndex* base,
+		const Chain<VarSet>* varsets, const Chain<VarSet>* base_varsets);
+
+	// Destruct this index layer.
+	~VarSetIndex();
+
+	// Return the first varset including the term with the given key, or 0 if none do.
+	const VarSet* find(const VarSetKey& key) const;
+};
+
+
 // =================== Bindings ======================
 
 class StepDomain;
 
+// Key of a cached affects query: two literals with their step ids.
+struct AffectsKey {
+	// The first literal.
+	const Literal* l1;
+	// Step id for the first literal.
+	size_t id1;
+	// The second literal.
+	const Literal* l2;
+	// Step id for the second literal.
+	size_t id2;
+
+	// Construct a key.
+	AffectsKey(const Literal* l1, size_t id1, const Literal* l2, size_t id2)
+		:l1(l1), id1(id1), l2(l2), id2(id2) {}
+
+	// Equality operator for keys.
+	bool operator==(const AffectsKey& k) const {
+		return l1 == k.l1 && id1 == k.id1 && l2 == k.l2 && id2 == k.id2;
+	}
+};
+
+// Hash function for affects query keys.
+struct AffectsKeyHash {
+	size_t operator()(const AffectsKey& k) const {
+		size_t h = size_t(k.l1);
+		h = h * 31 + k.id1;
+		h = h * 31 + size_t(k.l2);
+		return h * 31 + k.id2;
+	}
+};
+
 // A collection of variable bindings. diff here!!!
 class Bindings :public RCObject {
 
 	// Varsets representing the transitive closure of the bindings.
 	const Chain<VarSet>* varsets;
+	// Index of the varsets, or 0 if there are none.
+	const VarSetIndex* index;
 	// Highest step id of variable in varsets.
 	size_t high_step_id;
 	// Step domains.
 	const Chain<StepDomain>* step_domains;
+	// Serial number of this binding collection, unique among all binding collections.
+	size_t serial;
+	// Domains of variables without a step domain that exclude objects, by variable key.
+	mutable map<VarSetKey, const ObjectSet*> domains;
+	// Lock for the cached variable domains.
+	mutable mutex domain_lock;
+	// Results of affects queries without a unifier; the literals are referenced while cached.
+	mutable unordered_map<AffectsKey, bool, AffectsKeyHash> affects_cache;
+	// Lock for the cached affects results.
+	mutable mutex affects_lock;
 	// Reference counter.
 	mutable size_t ref_count;
 
 	// Construct a binding collection, empty by default.
 	Bindings();
 
-	// Construct a binding collection.
+	// Construct a binding collection refining the given binding collection.
 	Bindings(const Chain<VarSet>* varsets, size_t high_step_id,
-		const Chain<StepDomain>* step_domains);
+		const Chain<StepDomain>* step_domains, const Bindings& parent);
 
 public:
 	// Empty bindings.
@@ -345,6 +558,9 @@ public:
 	// Destruct this binding collection.
 	~Bindings();
 
+	// Return the serial number of this binding collection; no other binding collection has the same number.
+	size_t get_serial() const { return serial; }
+
 	// Check if the given formulas can be unified.
 	static bool is_unifiable(const Literal& l1, size_t id1,
 		const Literal& l2, size_t id2);
@@ -357,7 +573,8 @@ public:
 	// Return the binding for the given term, or the term itself if it is not bound to a single object.
 	Term get_binding(const Term& term, size_t step_id) const;
 
-	// Return the domain for the given step variable.
+	// Return the domain for the given step variable. The set is owned either by the term table of the problem or
+	// by these bindings, which memoize it, so the caller must never delete it.
 	const ObjectSet& get_domain(const Variable& var, size_t step_id,
 		const Problem& problem) const;
 
@@ -391,6 +608,10 @@ public:
 	const Bindings* add(size_t step_id, const Action& step_action,
 		const PlanningGraph& pg, bool test_only = false) const;
 
+	// Append the current varsets and step domains to the given plan signature, with step ids renumbered by the given map.
+	void add_signature(vector<size_t>& sig,
+		const map<size_t, size_t>& step_ids) const;
+
 	// Print this binding collection on the given stream.
 	void print(ostream& os) const;
 
@@ -1,6 +1,21 @@
 #pragma once
 
 #include "refcount.h"
+#include <cstddef>
+
+// Allocator of chain nodes, which may be specialized to draw the nodes of a chain type from a pool.
+template<class T>
+struct ChainAllocator {
+	// Return storage for a new chain node.
+	static void* allocate(size_t size) {
+		return ::operator new(size);
+	}
+
+	// Return the storage of a destroyed chain node.
+	static void deallocate(void* p) {
+		::operator delete(p);
+	}
+};
 
 // Template chain class.
 template<class T>
@@ -18,10 +33,20 @@ public:
 	}
 
 	// Destruct the chain.
-	Chain<T>() {
+	~Chain() {
 		destructive_deref(tail);
 	}
 
+	// Allocate a chain node.
+	static void* operator new(size_t size) {
+		return ChainAllocator<T>::allocate(size);
+	}
+
+	// Deallocate a chain node.
+	static void operator delete(void* p) {
+		ChainAllocator<T>::deallocate(p);
+	}
+
 	// Check if the chain contains the given element.
 	bool contains(const T& h) const {
 		for (const Chain<T>* ci = this; ci != 0; ci = ci->tail) {
@@ -73,7 +98,7 @@ public:
 		return tail;
 	}
 
-	T get_head() const {
+	const T& get_head() const {
 		return head;
 	}
 };
\ No newline at end of file
@@ -1,8 +1,69 @@
 #include "flaws.h"
+#include <atomic>
+
+//Id of the next flaw to be created. 
+static std::atomic<size_t> next_flaw_id(1);
+
+// Constructs a copy of the given refinement count.
+RefinementCount::RefinementCount(const RefinementCount& rc)
+	: version(0), count(-1), bindings(0), orderings(0) {
+	int c;
+	size_t b, o;
+	if (rc.read(c, b, o)) {
+		count = c;
+		bindings = b;
+		orderings = o;
+	}
+}
+
+
+// Read the cached number and the serial numbers it was counted with, and return false if the number was being cached.
+bool RefinementCount::read(int& count, size_t& bindings, size_t& orderings) const {
+	unsigned v = version;
+	if ((v & 1) != 0) {
+		return false;
+	}
+	count = this->count;
+	bindings = this->bindings;
+	orderings = this->orderings;
+	// The number is only consistent if no number was cached while it was read.
+	return version == v;
+}
+
+
+// Return the cached number of refinements if it was counted with the bindings and orderings with the given serial numbers, or -1 otherwise.
+int RefinementCount::get(size_t bindings, size_t orderings) const {
+	int c;
+	size_t b, o;
+	if (read(c, b, o) && c >= 0 && b == bindings && o == orderings) {
+		return c;
+	}
+	return -1;
+}
+
+
+// Cache the given number of refinements, counted with the bindings and orderings with the given serial numbers (zero for those it does not depend on).
+void RefinementCount::set(int count, size_t bindings, size_t orderings) const {
+	// A thread that finds another thread caching a number leaves the cache
+	// to it instead of waiting.
+	unsigned v = version;
+	if ((v & 1) != 0 || !version.compare_exchange_strong(v, v + 1)) {
+		return;
+	}
+	this->count = count;
+	this->bindings = bindings;
+	this->orderings = orderings;
+	version = v + 2;
+}
+
+// Constructs a flaw with a new id.
+Flaw::Flaw()
+	: id(next_flaw_id++) {}
 
 // Constructs an open condition.
 OpenCondition::OpenCondition(size_t step_id, const Formula& condition)
-	: step_id(step_id), condition(&condition) {
+	: step_id(step_id), condition(&condition),
+	value_version(0), value_bindings(0) {
 	Formula::register_use(this->condition);
 }
 
@@ -10,15 +71,26 @@ OpenCondition::OpenCondition(size_t step_id, const Formula& condition)
 // Constructs an open condition.
 OpenCondition::OpenCondition(size_t step_id, const Literal& condition,
 	FormulaTime when)
-	: step_id(step_id), condition(&condition), when(when) {
+	: step_id(step_id), condition(&condition), when(when),
+	value_version(0), value_bindings(0) {
 	Formula::register_use(this->condition);
 }
 
 
 // Copy constructor of an open condition.
 OpenCondition::OpenCondition(const OpenCondition& oc)
-	: step_id(oc.step_id), condition(oc.condition), when(oc.when) {
+	: Flaw(oc), step_id(oc.step_id), condition(oc.condition), when(oc.when),
+	value_version(0), value_bindings(0),
+	addable(oc.addable), reusable(oc.reusable) {
 	Formula::register_use(this->condition);
+	HeuristicValue h, hs;
+	size_t bindings;
+	if (oc.read_value(h, hs, bindings)) {
+		value_bindings = bindings;
+		value.store(h);
+		start_value.store(hs);
+		value_version = 2;
+	}
 }
 
 
@@ -38,17 +110,60 @@ bool OpenCondition::is_static() const {
 
 // Return a literal, or NULL if this is not a literal open condition.
 const Literal* OpenCondition::literal() const {
-	return dynamic_cast<const Literal*>(condition);
+	return condition->is_literal() ? static_cast<const Literal*>(condition) : NULL;
 }
 
 
 // Return a inequality, or NULL if this is not an inequality open condition.
 const Inequality* OpenCondition::inequality() const {
-	return dynamic_cast<const Inequality*>(condition);
+	return ((condition->get_kind() == INEQUALITY_F)
+		? static_cast<const Inequality*>(condition) : NULL);
 }
 
 
 // Return a disjunction, or NULL if this is not a disjunctive open condition.
 const Disjunction* OpenCondition::disjunction() const {
-	return dynamic_cast<const Disjunction*>(condition);
+	return ((condition->get_kind() == DISJUNCTION_F)
+		? static_cast<const Disjunction*>(condition) : NULL);
+}
+
+
+// Read the cached value of the condition and the serial number of the bindings it was computed with, and return false if no value was cached or it was being cached.
+bool OpenCondition::read_value(HeuristicValue& h, HeuristicValue& hs,
+	size_t& bindings) const {
+	unsigned version = value_version;
+	if (version == 0 || (version & 1) != 0) {
+		return false;
+	}
+	bindings = value_bindings;
+	h = value.load();
+	hs = start_value.load();
+	// The value is only consistent if no value was cached while it was read.
+	return value_version == version;
+}
+
+
+// Get the cached value of the condition if it was computed with the bindings with the given serial number, and return whether there was such a value.
+bool OpenCondition::get_cached_value(HeuristicValue& h, HeuristicValue& hs,
+	size_t bindings) const {
+	size_t value_bindings;
+	return (read_value(h, hs, value_bindings)
+		&& (value_bindings == 0 || value_bindings == bindings));
+}
+
+
+// Cache the given value of the condition, computed with the bindings with the given serial number (zero if the value does not depend on bindings).
+void OpenCondition::cache_value(const HeuristicValue& h,
+	const HeuristicValue& hs, size_t bindings) const {
+	// A thread that finds another thread caching a value leaves the cache
+	// to it instead of waiting.
+	unsigned version = value_version;
+	if ((version & 1) != 0
+		|| !value_version.compare_exchange_strong(version, version + 1)) {
+		return;
+	}
+	value_bindings = bindings;
+	value.store(h);
+	start_value.store(hs);
+	value_version = version + 2;
 }
\ No newline at end of file
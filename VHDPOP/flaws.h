@@ -1,18 +1,93 @@
 #pragma once
 
-#include "chain.h"
+#include "flawsets.h"
 #include "domains.h"
 #include "formulas.h"
 #include "plans.h"
+#include "heuristics.h"
+#include <atomic>
 
 class Domain;
 class Effect;
 class Link;
 
 
+// A heuristic value that several threads may read and write at once.  A
+// value read while it is being written may mix components of two values,
+// so readers check a version number written around it.
+class SharedHeuristicValue {
+	// Cost according to additive heuristic.
+	std::atomic<float> add_cost;
+	// Work according to additive heuristic.
+	std::atomic<int> add_work;
+	// Value according to the makespan heuristic.
+	std::atomic<float> makespan;
+
+public:
+	// Construct a zero heuristic value.
+	SharedHeuristicValue() : add_cost(0.0f), add_work(0), makespan(0.0f) {}
+
+	// Return this heuristic value.
+	HeuristicValue load() const {
+		return HeuristicValue(add_cost, add_work, makespan);
+	}
+
+	// Set this heuristic value to the given value.
+	void store(const HeuristicValue& v) {
+		add_cost = v.get_add_cost();
+		add_work = v.get_add_work();
+		makespan = v.get_makespan();
+	}
+};
+
+
+// A number of refinements of a flaw, cached with the flaw and shared by
+// all plans holding it.  The number is valid for the plans with the
+// bindings and orderings it was counted with.
+class RefinementCount {
+	// Version of the cached number, odd while a number is being cached.
+	mutable std::atomic<unsigned> version;
+	// Number of refinements, or -1 if no number has been cached.
+	mutable std::atomic<int> count;
+	// Serial number of the bindings the number was counted with, or zero if it does not depend on bindings.
+	mutable std::atomic<size_t> bindings;
+	// Serial number of the orderings the number was counted with, or zero if it does not depend on orderings.
+	mutable std::atomic<size_t> orderings;
+
+	// Read the cached number and the serial numbers it was counted with, and return false if the number was being cached.
+	bool read(int& count, size_t& bindings, size_t& orderings) const;
+
+public:
+	// Construct an empty refinement count.
+	RefinementCount() : version(0), count(-1), bindings(0), orderings(0) {}
+
+	// Construct a copy of the given refinement count.
+	RefinementCount(const RefinementCount& rc);
+
+	// Return the cached number of refinements if it was counted with the bindings and orderings with the given serial numbers, or -1 otherwise.
+	int get(size_t bindings, size_t orderings) const;
+
+	// Cache the given number of refinements, counted with the bindings and orderings with the given serial numbers (zero for those it does not depend on).
+	void set(int count, size_t bindings, size_t orderings) const;
+};
+
+
 // An abstract flaw
 class Flaw {
+	// Flaw id; a flaw created later has a higher id, and copies of a flaw share its id.
+	size_t id;
+
+protected:
+	// Construct a flaw with a new id.
+	Flaw();
+
+	// Copy constructor of a flaw.
+	Flaw(const Flaw& f) : id(f.id) {}
+
 public:
+	// Return the flaw id.
+	size_t get_id() const { return id; }
+
 	// Print this object on the given stream.
 	virtual void print(ostream& os, const Bindings& bindings) const = 0;
 };
@@ -25,6 +100,21 @@ class OpenCondition :public Flaw {
 	const Formula* condition;
 	// Time stamp associated with a literal open condition.
 	FormulaTime when;
+	// Version of the cached value, zero if no value has been cached and odd while a value is being cached.
+	mutable std::atomic<unsigned> value_version;
+	// Serial number of the bindings the cached value was computed with, or zero if the value does not depend on bindings.
+	mutable std::atomic<size_t> value_bindings;
+	// Cached value of the condition.
+	mutable SharedHeuristicValue value;
+	// Cached start value of the condition.
+	mutable SharedHeuristicValue start_value;
+	// Cached number of add-step refinements of a literal open condition.
+	RefinementCount addable;
+	// Cached number of reuse-step refinements of a literal open condition.
+	RefinementCount reusable;
+
+	// Read the cached value of the condition and the serial number of the bindings it was computed with, and return false if no value was cached or it was being cached.
+	bool read_value(HeuristicValue& h, HeuristicValue& hs, size_t& bindings) const;
 
 public:
 	// Construct an open condition.
@@ -60,6 +150,20 @@ public:
 	// Return a disjunction, or NULL if this is not a disjunctive open condition.
 	const Disjunction* disjunction() const;
 
+	// Get the cached value of the condition if it was computed with the bindings with the given serial number, and return whether there was such a value.
+	bool get_cached_value(HeuristicValue& h, HeuristicValue& hs,
+		size_t bindings) const;
+
+	// Cache the given value of the condition, computed with the bindings with the given serial number (zero if the value does not depend on bindings).
+	void cache_value(const HeuristicValue& h, const HeuristicValue& hs,
+		size_t bindings) const;
+
+	// Return the cached number of add-step refinements, which depends on the bindings only.
+	const RefinementCount& addable_count() const { return addable; }
+
+	// Return the cached number of reuse-step refinements, which depends on the bindings and the orderings (and through the orderings on the steps).
+	const RefinementCount& reusable_count() const { return reusable; }
+
 	// Print this object on the given stream.
 	virtual void print(ostream& os, const Bindings& bindings) const {
 		os << "#<OPEN ";
@@ -70,7 +174,7 @@ public:
 
 // Equality operator for open conditions.
 inline bool operator==(const OpenCondition& oc1, const OpenCondition& oc2) {
-	return &oc1 == &oc2;
+	return oc1.get_id() == oc2.get_id();
 }
 
 
@@ -85,6 +189,8 @@ class Unsafe :public Flaw {
 	size_t step_id;
 	// Threatening effect.
 	const Effect* effect;
+	// Cached number of separations of the threat.
+	RefinementCount separable;
 
 public:
 	// Construct a threatened causal link.
@@ -100,6 +206,9 @@ public:
 	// Return the threatening effect.
 	const Effect& get_effect() const { return *effect; }
 
+	// Return the cached number of separations of a real threat, which depends on the bindings only.
+	const RefinementCount& separable_count() const { return separable; }
+
 	// Print this object on the given stream.
 	virtual void print(ostream& os, const Bindings& bindings) const {
 		os << "#<UNSAFE " << get_link().get_from_id() << ' ';
@@ -110,7 +219,7 @@ public:
 
 // Equality operator for unsafe links.
 inline bool operator==(const Unsafe& u1, const Unsafe& u2) {
-	return &u1 == &u2;
+	return u1.get_id() == u2.get_id();
 }
 
 
@@ -162,5 +271,5 @@ public:
 
 // Equality operator for mutex threats.
 inline bool operator==(const MutexThreat& mt1, const MutexThreat& mt2) {
-	return &mt1 == &mt2;
+	return mt1.get_id() == mt2.get_id();
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "refcount.h"
+#include "pools.h"
+#include <algorithm>
+
+// Persistent set of flaws, ordered by flaw id.  A set is represented by its
+// root node, with the empty set being a null pointer.  The set is a
+// balanced binary tree, so adding and removing a flaw only copies the
+// nodes on a single path and shares all other nodes with the original
+// set.  Iteration visits the newest flaw (highest id) first, which is the
+// order in which a chain of flaws built by pushing new flaws to its front
+// would be visited.
+template<class T>
+class FlawSet :public RCObject {
+	// Maximum height of a tree; the height of a balanced tree with n nodes is below 1.45 log2(n + 2).
+	static const int MAX_HEIGHT = 64;
+
+	// Flaws with higher ids than the flaw of this node.
+	const FlawSet<T>* newer;
+	// Flaws with lower ids than the flaw of this node.
+	const FlawSet<T>* older;
+	// Height of the tree rooted at this node.
+	int height;
+
+	// Construct a node with the given flaw and subtrees.
+	FlawSet<T>(const T& flaw, const FlawSet<T>* newer, const FlawSet<T>* older)
+		:newer(newer), older(older),
+		height(1 + std::max(height_of(newer), height_of(older))), flaw(flaw) {
+		ref(newer);
+		ref(older);
+	}
+
+	// Return the height of the given tree.
+	static int height_of(const FlawSet<T>* set) {
+		return (set != 0) ? set->height : 0;
+	}
+
+	// Return a balanced tree with the given flaw and subtrees, whose heights may differ by at most two.
+	static const FlawSet<T>* balance(const T& flaw,
+		const FlawSet<T>* newer, const FlawSet<T>* older) {
+		int hn = height_of(newer);
+		int ho = height_of(older);
+		if (hn <= ho + 1 && ho <= hn + 1) {
+			return new FlawSet<T>(flaw, newer, older);
+		}
+		// A rotation may leave a fresh subtree unused, which is freed when
+		// the references taken here are given up.
+		ref(newer);
+		ref(older);
+		const FlawSet<T>* result;
+		if (hn > ho) {
+			if (height_of(newer->newer) >= height_of(newer->older)) {
+				result = new FlawSet<T>(newer->flaw, newer->newer,
+					new FlawSet<T>(flaw, newer->older, older));
+			}
+			else {
+				const FlawSet<T>* mid = newer->older;
+				result = new FlawSet<T>(mid->flaw,
+					new FlawSet<T>(newer->flaw, newer->newer, mid->newer),
+					new FlawSet<T>(flaw, mid->older, older));
+			}
+		}
+		else {
+			if (height_of(older->older) >= height_of(older->newer)) {
+				result = new FlawSet<T>(older->flaw,
+					new FlawSet<T>(flaw, newer, older->newer), older->older);
+			}
+			else {
+				const FlawSet<T>* mid = older->newer;
+				result = new FlawSet<T>(mid->flaw,
+					new FlawSet<T>(flaw, newer, mid->newer),
+					new FlawSet<T>(older->flaw, mid->older, older->older));
+			}
+		}
+		destructive_deref(newer);
+		destructive_deref(older);
+		return result;
+	}
+
+	// Return the given tree with the given flaw added.
+	static const FlawSet<T>* insert(const FlawSet<T>* set, const T& flaw) {
+		if (set == 0) {
+			return new FlawSet<T>(flaw, 0, 0);
+		}
+		else if (flaw.get_id() > set->flaw.get_id()) {
+			return balance(set->flaw, insert(set->newer, flaw), set->older);
+		}
+		else {
+			return balance(set->flaw, set->newer, insert(set->older, flaw));
+		}
+	}
+
+	// Return the given tree with the flaw with the given id removed.
+	static const FlawSet<T>* remove(const FlawSet<T>* set, size_t id) {
+		if (set == 0) {
+			return 0;
+		}
+		size_t set_id = set->flaw.get_id();
+		if (id > set_id) {
+			const FlawSet<T>* newer = remove(set->newer, id);
+			return (newer == set->newer) ? set : balance(set->flaw, newer, set->older);
+		}
+		else if (id < set_id) {
+			const FlawSet<T>* older = remove(set->older, id);
+			return (older == set->older) ? set : balance(set->flaw, set->newer, older);
+		}
+		else if (set->newer == 0) {
+			return set->older;
+		}
+		else if (set->older == 0) {
+			return set->newer;
+		}
+		else {
+			// Replace the flaw with the newest of the older flaws.
+			const FlawSet<T>* next = set->older;
+			while (next->newer != 0) {
+				next = next->newer;
+			}
+			return balance(next->flaw, set->newer,
+				remove(set->older, next->flaw.get_id()));
+		}
+	}
+
+public:
+	// The flaw of this node.
+	T flaw;
+
+	// Iterator over the flaws of a set, newest flaw first.
+	class const_iterator {
+		// Nodes whose flaw and older flaws remain to be visited; the top node holds the current flaw.
+		const FlawSet<T>* path[MAX_HEIGHT];
+		// Number of nodes on the path.
+		int depth;
+
+		// Push the given tree and its chain of newer subtrees onto the path.
+		void push_newest(const FlawSet<T>* set) {
+			for (; set != 0; set = set->newer) {
+				path[depth++] = set;
+			}
+		}
+
+	public:
+		// Construct an iterator positioned at the newest flaw of the given set.
+		const_iterator(const FlawSet<T>* set) :depth(0) {
+			push_newest(set);
+		}
+
+		// Check if all flaws have been visited.
+		bool at_end() const { return depth == 0; }
+
+		// Return the current flaw.
+		const T& operator*() const { return path[depth - 1]->flaw; }
+
+		// Return the current flaw.
+		const T* operator->() const { return &path[depth - 1]->flaw; }
+
+		// Advance to the next older flaw.
+		const_iterator& operator++() {
+			const FlawSet<T>* set = path[--depth];
+			push_newest(set->older);
+			return *this;
+		}
+	};
+
+	// Destruct this node.
+	~FlawSet() {
+		destructive_deref(newer);
+		destructive_deref(older);
+	}
+
+	// Allocate a node from the pool of nodes.
+	static void* operator new(size_t size) {
+		return SlabPool<FlawSet<T> >::allocate();
+	}
+
+	// Return a node to the pool of nodes.
+	static void operator delete(void* p) {
+		SlabPool<FlawSet<T> >::deallocate(p);
+	}
+
+	// Return the given set with the given flaw added.  Unlike a chain, the
+	// new set does not hold on to the given set, so the given set is freed
+	// if nothing else refers to it; flaws can thus be added one at a time.
+	static const FlawSet<T>* add(const FlawSet<T>* set, const T& flaw) {
+		ref(set);
+		const FlawSet<T>* result = insert(set, flaw);
+		ref(result);
+		destructive_deref(set);
+		deref(result);
+		return result;
+	}
+
+	// Return a set (pointer) with the given flaw removed.
+	const FlawSet<T>* remove(const T& flaw) const {
+		return remove(this, flaw.get_id());
+	}
+
+	// Return the newest flaw of this set.
+	const T& newest() const {
+		const FlawSet<T>* set = this;
+		while (set->newer != 0) {
+			set = set->newer;
+		}
+		return set->flaw;
+	}
+};
@@ -2,9 +2,16 @@
 #include "bindings.h"
 #include "problems.h"
 #include "domains.h"
+#include <mutex>
 #include <stack>
 
 
+// Lock for the tables of ground literals, which search threads may add to.
+static mutex literal_table_lock;
+// Lock for the cached universal bases of universally quantified formulas.
+static recursive_mutex universal_base_lock;
+
+
 //=================== Formula ====================
 
 // The true formula.
@@ -12,8 +19,8 @@ const Formula& Formula::TRUE_FORMULA = Constant::TRUE_CONSTANT;
 // The false formula.
 const Formula& Formula::FALSE_FORMULA = Constant::FALSE_CONSTANT;
 
-// Construct a formula.
-Formula::Formula() {
+// Construct a formula of the given kind.
+Formula::Formula(FormulaKind kind) :kind(kind) {
 #ifdef DEBUG_MEMORY
 	++created_formulas;
 #endif // DEBUG_MEMORY
@@ -57,7 +64,8 @@ const Formula& operator&&(const Formula& f1, const Formula& f2) {
 	}
 	else {
 		Conjunction& conjunction = *new Conjunction();
-		const Conjunction* c1 = dynamic_cast<const Conjunction*>(&f1);
+		const Conjunction* c1 = ((f1.get_kind() == CONJUNCTION_F)
+			? static_cast<const Conjunction*>(&f1) : NULL);
 		if (c1 != NULL) {
 			for (FormulaList::const_iterator fi = c1->get_conjuncts().begin();
 				fi != c1->get_conjuncts().end(); fi++) {
@@ -69,7 +77,8 @@ const Formula& operator&&(const Formula& f1, const Formula& f2) {
 		else {
 			conjunction.add_conjunct(f1);
 		}
-		const Conjunction* c2 = dynamic_cast<const Conjunction*>(&f2);
+		const Conjunction* c2 = ((f2.get_kind() == CONJUNCTION_F)
+			? static_cast<const Conjunction*>(&f2) : NULL);
 		if (c2 != NULL) {
 			for (FormulaList::const_iterator fi = c2->get_conjuncts().begin();
 				fi != c2->get_conjuncts().end(); fi++) {
@@ -108,7 +117,8 @@ const Formula& operator||(const Formula& f1, const Formula& f2) {
 	}
 	else {
 		Disjunction& disjunction = *new Disjunction();
-		const Disjunction* d1 = dynamic_cast<const Disjunction*>(&f1);
+		const Disjunction* d1 = ((f1.get_kind() == DISJUNCTION_F)
+			? static_cast<const Disjunction*>(&f1) : NULL);
 		if (d1 != NULL) {
 			for (FormulaList::const_iterator fi = d1->get_disjuncts().begin();
 				fi != d1->get_disjuncts().end(); fi++) {
@@ -120,7 +130,8 @@ const Formula& operator||(const Formula& f1, const Formula& f2) {
 		else {
 			disjunction.add_disjunct(f1);
 		}
-		const Disjunction* d2 = dynamic_cast<const Disjunction*>(&f2);
+		const Disjunction* d2 = ((f2.get_kind() == DISJUNCTION_F)
+			? static_cast<const Disjunction*>(&f2) : NULL);
 		if (d2 != NULL) {
 			for (FormulaList::const_iterator fi = d2->get_disjuncts().begin();
 				fi != d2->get_disjuncts().end(); fi++) {
@@ -144,7 +155,7 @@ const Constant Constant::TRUE_CONSTANT = Constant(true);
 const Constant Constant::FALSE_CONSTANT = Constant(false);
 
 // Construct a constant formula.
-Constant::Constant(bool value) :value(value) {
+Constant::Constant(bool value) :Formula(CONSTANT_F), value(value) {
 	register_use(this);
 #ifdef DEBUG_MEMORY
 	--created_formulas;
@@ -295,8 +306,9 @@ bool Atom::AtomLess::operator()(const Atom* a1, const Atom* a2) const {
 
 // Destruct this atomic formula. 
 Atom::~Atom() {
+	lock_guard<mutex> lock(literal_table_lock);
 	AtomTable::const_iterator ai = atoms.find(this);
-	if (*ai == this) {
+	if (ai != atoms.end() && *ai == this) {
 		atoms.erase(ai);
 	}
 }
@@ -321,10 +333,13 @@ const Atom& Atom::make(const Predicate& predicate, const TermList& terms) {
 		return *atom;
 	}
 	else {
+		unique_lock<mutex> lock(literal_table_lock);
 		pair<AtomTable::const_iterator, bool> result = atoms.insert(atom);
 		if (!result.second) {
+			const Atom& old_atom = **result.first;
+			lock.unlock();
 			delete atom;
-			return **result.first;
+			return old_atom;
 		}
 		else {
 			atom->assign_id(ground);
@@ -440,7 +455,7 @@ bool Negation::NegationLess::operator()(const Negation* n1,
 
 // Construct a negated atom. 
 Negation::Negation(const Atom& atom)
-	:atom(&atom) {
+	:Literal(NEGATION_F), atom(&atom) {
 	register_use(this->atom);
 }
 
@@ -458,11 +473,14 @@ const Negation& Negation::make(const Atom& atom) {
 		return *negation;
 	}
 	else {
+		unique_lock<mutex> lock(literal_table_lock);
 		pair<NegationTable::const_iterator, bool> result =
 			negations.insert(negation);
 		if (!result.second) {
+			const Negation& old_negation = **result.first;
+			lock.unlock();
 			delete negation;
-			return **result.first;
+			return old_negation;
 		}
 		else {
 			negation->assign_id(ground);
@@ -473,11 +491,14 @@ const Negation& Negation::make(const Atom& atom) {
 
 // Destruct this negated atom. 
 Negation::~Negation() {
-	unregister_use(atom);
-	NegationTable::const_iterator ni = negations.find(this);
-	if (*ni == this) {
-		negations.erase(ni);
+	{
+		lock_guard<mutex> lock(literal_table_lock);
+		NegationTable::const_iterator ni = negations.find(this);
+		if (ni != negations.end() && *ni == this) {
+			negations.erase(ni);
+		}
 	}
+	unregister_use(atom);
 }
 
 // Return this formula subject to the given substitutions. 
@@ -1455,6 +1476,7 @@ const Formula& Forall::get_instantiation(const SubstitutionMap& subst,
 // Return the universal base of this formula.
 const Formula& Forall::get_universal_base(const SubstitutionMap& subst,
 	const Problem& problem) const {
+	lock_guard<recursive_mutex> lock(universal_base_lock);
 	if (universal_base != NULL) {
 		return *universal_base;
 	}
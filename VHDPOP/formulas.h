@@ -16,15 +16,22 @@ class PlanningGraph;
 
 class Literal;
 
+// Kind of a formula, one for each concrete formula class.
+typedef enum { CONSTANT_F, ATOM_F, NEGATION_F, EQUALITY_F, INEQUALITY_F,
+	CONJUNCTION_F, DISJUNCTION_F, EXISTS_F, FORALL_F, TIMED_LITERAL_F } FormulaKind;
+
 // Abstract formula.
 class Formula :public RCObject{
 
 	// Negation operator for formulas.
 	friend const Formula& operator!(const Formula& f);
 
+	// Kind of this formula.
+	FormulaKind kind;
+
 protected:
-	// Construct a formula.
-	Formula();
+	// Construct a formula of the given kind.
+	explicit Formula(FormulaKind kind);
 
 	// Return the negation of this formula.
 	virtual const Formula& negation() const = 0;
@@ -50,6 +57,12 @@ public:
 		destructive_deref(f);
 	}
 
+	// Return the kind of this formula; checking the kind is much cheaper than a dynamic cast.
+	FormulaKind get_kind() const { return kind; }
+
+	// Test if this formula is a literal (an atom or a negated atom).
+	bool is_literal() const { return kind == ATOM_F || kind == NEGATION_F; }
+
 	// Test if this formula is a tautology.
 	bool is_tautology() const { return this == &TRUE_FORMULA; }
 
@@ -158,6 +171,9 @@ class Literal :public Formula {
 	size_t id;
 
 protected:
+	// Construct a literal of the given kind.
+	explicit Literal(FormulaKind kind) :Formula(kind) {}
+
 	// Assign an index to this literal.
 	void assign_id(bool ground);
 
@@ -222,12 +238,20 @@ class Atom : public Literal {
 	Predicate predicate;
 	// Terms of this atom. 
 	TermList terms;
+	// Positions of the terms that are objects, for the first 64 terms.
+	unsigned long long object_positions;
 
 	// Construct an atomic formula with the given predicate. 
-	explicit Atom(const Predicate& predicate) : predicate(predicate) {}
+	explicit Atom(const Predicate& predicate)
+		: Literal(ATOM_F), predicate(predicate), object_positions(0) {}
 
 	// Add a term to this atomic formula. 
-	void add_term(const Term& term) { terms.push_back(term); }
+	void add_term(const Term& term) {
+		if (term.is_object() && terms.size() < 64) {
+			object_positions |= 1ULL << terms.size();
+		}
+		terms.push_back(term);
+	}
 
 protected:
 	// Return the negation of this formula. 
@@ -249,6 +273,9 @@ public:
 	// Return the ith term of this literal. 
 	virtual const Term& get_term(size_t i) const { return terms[i]; }
 
+	// Return the positions of the terms that are objects, for the first 64 terms.
+	unsigned long long get_object_positions() const { return object_positions; }
+
 	// Return the atom associated with this literal. 
 	virtual const Atom& get_atom() const { return *this; }
 
@@ -381,9 +408,9 @@ class BindingLiteral : public Formula {
 
 protected:
 	// Construct a binding literal.
-	BindingLiteral(const Variable& variable, size_t id1,
+	BindingLiteral(FormulaKind kind, const Variable& variable, size_t id1,
 		const Term& term, size_t id2)
-		: variable(variable), id1(id1), term(term), id2(id2) {}
+		: Formula(kind), variable(variable), id1(id1), term(term), id2(id2) {}
 
 public:
 	// Return the variable of this binding literal.
@@ -414,7 +441,7 @@ class Equality :public BindingLiteral {
 
 	// Construct an equality with assigned step ids.
 	Equality(const Variable& variable, size_t id1, const Term& term, size_t id2)
-		: BindingLiteral(variable, id1, term, id2) {}
+		: BindingLiteral(EQUALITY_F, variable, id1, term, id2) {}
 
 protected:
 	// Return the negation of this formula.
@@ -457,7 +484,7 @@ class Inequality :public BindingLiteral {
 
 	// Construct an equality with assigned step ids.
 	Inequality(const Variable& variable, size_t id1, const Term& term, size_t id2)
-		: BindingLiteral(variable, id1, term, id2) {}
+		: BindingLiteral(INEQUALITY_F, variable, id1, term, id2) {}
 
 protected:
 	// Return the negation of this formula.
@@ -506,7 +533,7 @@ protected:
 
 public:
 	// Construct an empty conjunction.
-	Conjunction(){}
+	Conjunction() :Formula(CONJUNCTION_F) {}
 
 	// Destruct this conjunction.
 	virtual ~Conjunction() {
@@ -564,7 +591,7 @@ protected:
 
 public:
 	// Construct an empty disjunction.
-	Disjunction() {}
+	Disjunction() :Formula(DISJUNCTION_F) {}
 
 	// Destruct this disjunction.
 	virtual ~Disjunction() {
@@ -621,8 +648,8 @@ class Quantification :public Formula {
 
 protected:
 	// Construct a quantified formula.
-	explicit Quantification(const Formula& body)
-		:body(&body) {
+	Quantification(FormulaKind kind, const Formula& body)
+		:Formula(kind), body(&body) {
 		register_use(this->body);
 	}
 
@@ -671,7 +698,7 @@ protected:
 public:
 	// Constructs an existentially quantified formula.
 	Exists()
-		:Quantification(FALSE_FORMULA) {
+		:Quantification(EXISTS_F, FALSE_FORMULA) {
 	}
 
 	// Return this formula subject to the given substitutions.
@@ -711,7 +738,7 @@ protected:
 public:
 	// Construct a universally quantified formula.
 	Forall()
-		:Quantification(TRUE_FORMULA), universal_base(0) {
+		:Quantification(FORALL_F, TRUE_FORMULA), universal_base(0) {
 	}
 
 	// Return this formula subject to the given substitutions.
@@ -752,7 +779,7 @@ class TimedLiteral :public Formula {
 
 	// Construct a timed literal.
 	TimedLiteral(const Literal& literal, FormulaTime when)
-		:literal(&literal), when(when) {
+		:Formula(TIMED_LITERAL_F), literal(&literal), when(when) {
 		register_use(this->literal);
 	}
 
@@ -5,6 +5,7 @@
 #include "plans.h"
 #include "problems.h"
 #include <algorithm>
+#include <mutex>
 
 extern int verbosity;
 
@@ -22,6 +23,64 @@ static int sum(int n, int m) {
 		n + m : numeric_limits<int>::max();
 }
 
+// Return the literal of the given formula, or NULL if it is not a (timed) literal; the time of a timed literal is stored in the given time.
+static const Literal* formula_literal(FormulaTime& when, const Formula& formula) {
+	if (formula.get_kind() == TIMED_LITERAL_F) {
+		const TimedLiteral& tl = static_cast<const TimedLiteral&>(formula);
+		when = tl.get_when();
+		return &tl.get_literal();
+	}
+	else {
+		when = AT_START_F;
+		return formula.is_literal() ? static_cast<const Literal*>(&formula) : NULL;
+	}
+}
+
+// Check if an existing step of the given plan can achieve the given literal
+// for the given step at the given time, and set the heuristic value for
+// reusing that step if so.
+static bool reuse_value(HeuristicValue& h, HeuristicValue& hs,
+	const Literal& literal, FormulaTime when, size_t step_id,
+	const Plan& plan) {
+	const Bindings* bindings = plan.get_bindings();
+	StepTime gt = start_time(when);
+	if (!PredicateTable::is_static(literal.get_predicate())) {
+		for (const Chain<Step>* sc = plan.get_steps(); sc != NULL; sc = sc->tail) {
+			const Step& step = sc->head;
+			if (step.get_id() != 0
+				&& plan.get_orderings().possibly_before(step.get_id(),
+					StepTime::AT_START,
+					step_id, gt)) {
+				const EffectList& effs = step.get_action().get_effects();
+				for (EffectList::const_iterator ei = effs.begin();
+					ei != effs.end(); ei++) {
+					const Effect& e = **ei;
+					StepTime et = end_time(e);
+					if (plan.get_orderings().possibly_before(step.get_id(), et,
+						step_id, gt)) {
+						if (literal.get_kind() == e.get_literal().get_kind()) {
+							if ((bindings != NULL
+								&& bindings->unify(literal, step_id,
+									e.get_literal(), step.get_id()))
+								|| (bindings == NULL && &literal == &e.get_literal())) {
+								h = HeuristicValue::ZERO_COST_UNIT_WORK;
+								if (when != AT_END) {
+									hs = HeuristicValue::ZERO_COST_UNIT_WORK;
+								}
+								else {
+									hs = HeuristicValue::ZERO;
+								}
+								return true;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
 // Compute the heuristic value of the given formula.
 static void formula_value(HeuristicValue& h, HeuristicValue& hs,
 	const Formula& formula, size_t step_id,
@@ -29,99 +88,91 @@ static void formula_value(HeuristicValue& h, HeuristicValue& hs,
 	bool reuse = false) {
 	const Bindings* bindings = plan.get_bindings();
 	if (reuse) {
-		const Literal* literal;
 		FormulaTime when;
-		const TimedLiteral* tl = dynamic_cast<const TimedLiteral*>(&formula);
-		if (tl != NULL) {
-			literal = &tl->get_literal();
-			when = tl->get_when();
-		}
-		else {
-			literal = dynamic_cast<const Literal*>(&formula);
-			when = AT_START_F;
-		}
+		const Literal* literal = formula_literal(when, formula);
 		if (literal != NULL) {
-			StepTime gt = start_time(when);
-			if (!PredicateTable::is_static(literal->get_predicate())) {
-				for (const Chain<Step>* sc = plan.get_steps(); sc != NULL; sc = sc->tail) {
-					const Step& step = sc->head;
-					if (step.get_id() != 0
-						&& plan.get_orderings().possibly_before(step.get_id(),
-							StepTime::AT_START,
-							step_id, gt)) {
-						const EffectList& effs = step.get_action().get_effects();
-						for (EffectList::const_iterator ei = effs.begin();
-							ei != effs.end(); ei++) {
-							const Effect& e = **ei;
-							StepTime et = end_time(e);
-							if (plan.get_orderings().possibly_before(step.get_id(), et,
-								step_id, gt)) {
-								if (typeid(*literal) == typeid(e.get_literal())) {
-									if ((bindings != NULL
-										&& bindings->unify(*literal, step_id,
-											e.get_literal(), step.get_id()))
-										|| (bindings == NULL && literal == &e.get_literal())) {
-										h = HeuristicValue::ZERO_COST_UNIT_WORK;
-										if (when != AT_END) {
-											hs = HeuristicValue::ZERO_COST_UNIT_WORK;
-										}
-										else {
-											hs = HeuristicValue::ZERO;
-										}
-										return;
-									}
-								}
-							}
-						}
-					}
-				}
+			if (reuse_value(h, hs, *literal, when, step_id, plan)) {
+				return;
 			}
 		}
 		else {
-			const Disjunction* disj = dynamic_cast<const Disjunction*>(&formula);
-			if (disj != NULL) {
+			switch (formula.get_kind()) {
+			case DISJUNCTION_F:
+			{
+				const Disjunction& disj = static_cast<const Disjunction&>(formula);
 				h = hs = HeuristicValue::INFINITE;
-				for (FormulaList::const_iterator fi = disj->get_disjuncts().begin();
-					fi != disj->get_disjuncts().end(); fi++) {
+				for (FormulaList::const_iterator fi = disj.get_disjuncts().begin();
+					fi != disj.get_disjuncts().end(); fi++) {
 					HeuristicValue hi, hsi;
 					formula_value(hi, hsi, **fi, step_id, plan, pg, true);
 					h = min(h, hi);
 					hs = min(hs, hsi);
 				}
 			}
-			else {
-				const Conjunction* conj = dynamic_cast<const Conjunction*>(&formula);
-				if (conj != NULL) {
-					h = hs = HeuristicValue::ZERO;
-					for (FormulaList::const_iterator fi = conj->get_conjuncts().begin();
-						fi != conj->get_conjuncts().end(); fi++) {
-						HeuristicValue hi, hsi;
-						formula_value(hi, hsi, **fi, step_id, plan, pg, true);
-						h += hi;
-						hs += hsi;
-					}
-				}
-				else {
-					const Exists* exists = dynamic_cast<const Exists*>(&formula);
-					if (exists != NULL) {
-						formula_value(h, hs, exists->get_body(), step_id, plan, pg, true);
-					}
-					else {
-						const Forall* forall = dynamic_cast<const Forall*>(&formula);
-						if (forall != NULL) {
-							formula_value(h, hs, forall->get_universal_base(SubstitutionMap(),
-								pg.get_problem()),
-								step_id, plan, pg, true);
-						}
-					}
+			break;
+			case CONJUNCTION_F:
+			{
+				const Conjunction& conj = static_cast<const Conjunction&>(formula);
+				h = hs = HeuristicValue::ZERO;
+				for (FormulaList::const_iterator fi = conj.get_conjuncts().begin();
+					fi != conj.get_conjuncts().end(); fi++) {
+					HeuristicValue hi, hsi;
+					formula_value(hi, hsi, **fi, step_id, plan, pg, true);
+					h += hi;
+					hs += hsi;
 				}
 			}
+			break;
+			case EXISTS_F:
+				formula_value(h, hs, static_cast<const Exists&>(formula).get_body(),
+					step_id, plan, pg, true);
+				break;
+			case FORALL_F:
+				formula_value(h, hs,
+					static_cast<const Forall&>(formula).get_universal_base(SubstitutionMap(),
+						pg.get_problem()),
+					step_id, plan, pg, true);
+				break;
+			default:
+				break;
+			}
 			return;
 		}
 	}
 	formula.get_heuristic_value(h, hs, pg, step_id, bindings);
 }
 
+// Compute the heuristic value of the condition of the given open condition.
+// Without reuse, the value only depends on the bindings, and not even on
+// them for a ground literal, so the value cached with the open condition is
+// used if it was computed with the same bindings; plans share most of their
+// open conditions with their parent, and often their bindings as well.
+static void open_condition_value(HeuristicValue& h, HeuristicValue& hs,
+	const OpenCondition& open_cond, const Plan& plan, const PlanningGraph& pg,
+	bool reuse = false) {
+	const Formula& condition = open_cond.get_condition();
+	size_t step_id = open_cond.get_step_id();
+	FormulaTime when;
+	const Literal* literal = formula_literal(when, condition);
+	if (reuse) {
+		if (literal == NULL) {
+			formula_value(h, hs, condition, step_id, plan, pg, true);
+			return;
+		}
+		else if (reuse_value(h, hs, *literal, when, step_id, plan)) {
+			return;
+		}
+	}
+	const Bindings* bindings = plan.get_bindings();
+	size_t serial = ((bindings != NULL
+		&& (literal == NULL || literal != &condition || literal->get_id() == 0))
+		? bindings->get_serial() : 0);
+	if (!open_cond.get_cached_value(h, hs, serial)) {
+		condition.get_heuristic_value(h, hs, pg, step_id, bindings);
+		open_cond.cache_value(h, hs, serial);
+	}
+}
+
 
 // ============== Heuristic evaluation functions for formulas. ==============
 
@@ -450,12 +501,11 @@ void Heuristic::plan_rank(vector<float>& rank, const Plan& plan,
 		case ADD_WORK:
 			if (!add_done) {
 				add_done = true;
-				for (const Chain<OpenCondition>* occ = plan.get_open_conds();
-					occ != NULL; occ = occ->tail) {
-					const OpenCondition& open_cond = occ->head;
+				for (FlawSet<OpenCondition>::const_iterator oi(plan.get_open_conds());
+					!oi.at_end(); ++oi) {
+					const OpenCondition& open_cond = *oi;
 					HeuristicValue v, vs;
-					formula_value(v, vs, open_cond.get_condition(), open_cond.get_step_id(),
-						plan, *planning_graph);
+					open_condition_value(v, vs, open_cond, plan, *planning_graph);
 					add_cost += v.get_add_cost();
 					add_work = sum(add_work, v.get_add_work());
 				}
@@ -490,12 +540,11 @@ void Heuristic::plan_rank(vector<float>& rank, const Plan& plan,
 		case ADDR_WORK:
 			if (!addr_done) {
 				addr_done = true;
-				for (const Chain<OpenCondition>* occ = plan.get_open_conds();
-					occ != NULL; occ = occ->tail) {
-					const OpenCondition& open_cond = occ->head;
+				for (FlawSet<OpenCondition>::const_iterator oi(plan.get_open_conds());
+					!oi.at_end(); ++oi) {
+					const OpenCondition& open_cond = *oi;
 					HeuristicValue v, vs;
-					formula_value(v, vs, open_cond.get_condition(), open_cond.get_step_id(),
-						plan, *planning_graph, true);
+					open_condition_value(v, vs, open_cond, plan, *planning_graph, true);
 					addr_cost += v.get_add_cost();
 					addr_work = sum(addr_work, v.get_add_work());
 				}
@@ -527,35 +576,37 @@ void Heuristic::plan_rank(vector<float>& rank, const Plan& plan,
 			break;
 		case MAKESPAN:
 			map<pair<size_t, StepTime::StepPoint>, float> min_times;
-			for (const Chain<OpenCondition>* occ = plan.get_open_conds();
-				occ != NULL; occ = occ->tail) {
-				const OpenCondition& open_cond = occ->head;
-				HeuristicValue v, vs;
-				formula_value(v, vs, open_cond.get_condition(), open_cond.get_step_id(),
-					plan, *planning_graph);
-				map<pair<size_t, StepTime::StepPoint>, float>::iterator di =
-					min_times.find(make_pair(open_cond.get_step_id(), StepTime::START));
-				if (di != min_times.end()) {
-					if (weight*vs.get_makespan() > (*di).second) {
-						(*di).second = weight * vs.get_makespan();
+			// Temporal orderings keep their makespan up to date themselves.
+			if (plan.get_orderings().uses_min_times()) {
+				for (FlawSet<OpenCondition>::const_iterator oi(plan.get_open_conds());
+					!oi.at_end(); ++oi) {
+					const OpenCondition& open_cond = *oi;
+					HeuristicValue v, vs;
+					open_condition_value(v, vs, open_cond, plan, *planning_graph);
+					map<pair<size_t, StepTime::StepPoint>, float>::iterator di =
+						min_times.find(make_pair(open_cond.get_step_id(), StepTime::START));
+					if (di != min_times.end()) {
+						if (weight*vs.get_makespan() > (*di).second) {
+							(*di).second = weight * vs.get_makespan();
+						}
 					}
-				}
-				else {
-					min_times.insert(make_pair(make_pair(open_cond.get_step_id(),
-						StepTime::START),
-						weight*vs.get_makespan()));
-				}
-				di = min_times.find(make_pair(open_cond.get_step_id(),
-					StepTime::END));
-				if (di != min_times.end()) {
-					if (weight*v.get_makespan() > (*di).second) {
-						(*di).second = weight * v.get_makespan();
+					else {
+						min_times.insert(make_pair(make_pair(open_cond.get_step_id(),
+							StepTime::START),
+							weight*vs.get_makespan()));
+					}
+					di = min_times.find(make_pair(open_cond.get_step_id(),
+						StepTime::END));
+					if (di != min_times.end()) {
+						if (weight*v.get_makespan() > (*di).second) {
+							(*di).second = weight * v.get_makespan();
+						}
+					}
+					else {
+						min_times.insert(make_pair(make_pair(open_cond.get_step_id(),
+							StepTime::END),
+							weight*v.get_makespan()));
 					}
-				}
-				else {
-					min_times.insert(make_pair(make_pair(open_cond.get_step_id(),
-						StepTime::END),
-						weight*v.get_makespan()));
 				}
 			}
 			rank.push_back(plan.get_orderings().makespan(min_times));
@@ -566,8 +617,234 @@ void Heuristic::plan_rank(vector<float>& rank, const Plan& plan,
 
 
 
+//=================== AtomIndex ====================
+
+// Lock for the lowest values of patterns of bound arguments that have not been published.
+static mutex pattern_lock;
+
+// Destruct this index.
+AtomIndex::~AtomIndex() {
+	delete published_values.load();
+	for (vector<const PatternValueMap*>::const_iterator mi = retired_values.begin();
+		mi != retired_values.end(); mi++) {
+		delete *mi;
+	}
+}
+
+// Add the given atom with the given value to this index.
+void AtomIndex::add(const Atom& atom, const HeuristicValue& value) {
+	size_t pos = atoms.size();
+	atoms.push_back(&atom);
+	values.push_back(value);
+	if (postings.size() < atom.get_arity()) {
+		postings.resize(atom.get_arity());
+	}
+	for (size_t i = 0; i < atom.get_arity(); i++) {
+		postings[i][atom.get_term(i).get_index()].push_back(pos);
+	}
+}
+
+
+// Return the positions of the atoms with the given object at the given argument position, or NULL if there are none.
+const vector<size_t>* AtomIndex::find_postings(size_t position,
+	int object) const {
+	if (position < postings.size()) {
+		ObjectAtomsMap::const_iterator oi = postings[position].find(object);
+		if (oi != postings[position].end()) {
+			return &(*oi).second;
+		}
+	}
+	return NULL;
+}
+
+
+// Check if the given atom has the objects of the given pattern.
+bool AtomIndex::matches(const Atom& atom, const vector<int>& pattern) {
+	for (size_t i = 0; i < pattern.size(); i++) {
+		if (pattern[i] >= 0 && atom.get_term(i).get_index() != pattern[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Return the lowest value of the atoms matching the given pattern, which are among the given candidates.
+HeuristicValue AtomIndex::pattern_value(const vector<int>& pattern,
+	const vector<size_t>* candidates) const {
+	const PatternValueMap* published = published_values.load(memory_order_acquire);
+	if (published != NULL) {
+		PatternValueMap::const_iterator pi = published->find(pattern);
+		if (pi != published->end()) {
+			return (*pi).second;
+		}
+	}
+	lock_guard<mutex> lock(pattern_lock);
+	// Another thread may have found the value since the map was read.
+	published = published_values.load(memory_order_relaxed);
+	if (published != NULL) {
+		PatternValueMap::const_iterator pi = published->find(pattern);
+		if (pi != published->end()) {
+			return (*pi).second;
+		}
+	}
+	PatternValueMap::const_iterator pi = pending_values.find(pattern);
+	if (pi != pending_values.end()) {
+		return (*pi).second;
+	}
+	HeuristicValue value = HeuristicValue::INFINITE;
+	size_t n = (candidates != NULL) ? candidates->size() : atoms.size();
+	for (size_t k = 0; k < n; k++) {
+		size_t pos = (candidates != NULL) ? (*candidates)[k] : k;
+		if (matches(*atoms[pos], pattern)) {
+			value = min(value, values[pos]);
+		}
+	}
+	pending_values.insert(make_pair(pattern, value));
+	// A new map is published once there are as many pending values as
+	// published ones, so each value is copied a constant number of times.
+	if (published == NULL || pending_values.size() >= published->size()) {
+		PatternValueMap* merged = (published != NULL)
+			? new PatternValueMap(*published) : new PatternValueMap();
+		merged->insert(pending_values.begin(), pending_values.end());
+		pending_values.clear();
+		if (published != NULL) {
+			retired_values.push_back(published);
+		}
+		published_values.store(merged, memory_order_release);
+	}
+	return value;
+}
+
+
+// Return the lowest value of the atoms in this index that unify with the given atom, or an infinite value if there are none.
+HeuristicValue AtomIndex::find_min(const Atom& atom, size_t step_id,
+	const Bindings& bindings) const {
+	// Only atoms with the objects that the arguments are bound to can unify;
+	// the shortest list of atoms with one of these objects is searched.
+	vector<int> pattern(atom.get_arity(), -1);
+	const vector<size_t>* candidates = NULL;
+	for (size_t i = 0; i < atom.get_arity(); i++) {
+		Term term = bindings.get_binding(atom.get_term(i), step_id);
+		if (term.is_object()) {
+			const vector<size_t>* objects = find_postings(i, term.get_index());
+			if (objects == NULL) {
+				return HeuristicValue::INFINITE;
+			}
+			if (candidates == NULL || objects->size() < candidates->size()) {
+				candidates = objects;
+			}
+			pattern[i] = term.get_index();
+		}
+	}
+	HeuristicValue lowest = pattern_value(pattern, candidates);
+	HeuristicValue value = HeuristicValue::INFINITE;
+	if (lowest.is_infinite()) {
+		return value;
+	}
+	size_t n = (candidates != NULL) ? candidates->size() : atoms.size();
+	for (size_t k = 0; k < n; k++) {
+		size_t pos = (candidates != NULL) ? (*candidates)[k] : k;
+		const Atom& a = *atoms[pos];
+		if (matches(a, pattern) && bindings.unify(atom, step_id, a, 0)) {
+			value = min(value, values[pos]);
+			if (value.is_zero() || !(value != lowest)) {
+				// No atom matching the pattern has a lower value.
+				return value;
+			}
+		}
+	}
+	return value;
+}
+
+
 //=================== PlanningGraph ====================
 
+// A literal whose value has been lowered, waiting to be propagated to the actions that it is a condition of.
+struct PlanningGraph::ValueEvent {
+	// Value of the literal when the event was queued.
+	HeuristicValue value;
+	// Id of the atom of the literal.
+	size_t id;
+	// Whether the literal is the negation of the atom.
+	bool negated;
+
+	// Construct an event for the given literal.
+	ValueEvent(const HeuristicValue& value, size_t id, bool negated)
+		:value(value), id(id), negated(negated) {}
+};
+
+
+// Heap order of value events, with the lowest value first.
+struct PlanningGraph::ValueEventOrder {
+	// Check if the first event is to be processed after the second.
+	bool operator()(const ValueEvent& e1, const ValueEvent& e2) const {
+		const HeuristicValue& v1 = e1.value;
+		const HeuristicValue& v2 = e2.value;
+		if (v1.get_add_cost() != v2.get_add_cost()) {
+			return v1.get_add_cost() > v2.get_add_cost();
+		}
+		else if (v1.get_add_work() != v2.get_add_work()) {
+			return v1.get_add_work() > v2.get_add_work();
+		}
+		else {
+			return v1.get_makespan() > v2.get_makespan();
+		}
+	}
+};
+
+
+// Collect the literals of the given formula, marking the literals without a value of which the start value of the formula is infinite.
+static void condition_literals(map<const Literal*, bool>& literals,
+	const Formula& formula, const Problem& problem, bool required) {
+	switch (formula.get_kind()) {
+	case ATOM_F:
+	case NEGATION_F:
+	{
+		const Literal* literal = static_cast<const Literal*>(&formula);
+		literals[literal] = literals[literal] || required;
+	}
+	break;
+	case TIMED_LITERAL_F:
+	{
+		const TimedLiteral& tl = static_cast<const TimedLiteral&>(formula);
+		condition_literals(literals, tl.get_literal(), problem,
+			required && tl.get_when() == AT_START_F);
+	}
+	break;
+	case CONJUNCTION_F:
+	{
+		const Conjunction& conj = static_cast<const Conjunction&>(formula);
+		for (FormulaList::const_iterator fi = conj.get_conjuncts().begin();
+			fi != conj.get_conjuncts().end(); fi++) {
+			condition_literals(literals, **fi, problem, required);
+		}
+	}
+	break;
+	case DISJUNCTION_F:
+	{
+		const Disjunction& disj = static_cast<const Disjunction&>(formula);
+		for (FormulaList::const_iterator fi = disj.get_disjuncts().begin();
+			fi != disj.get_disjuncts().end(); fi++) {
+			condition_literals(literals, **fi, problem, false);
+		}
+	}
+	break;
+	case EXISTS_F:
+		condition_literals(literals, static_cast<const Exists&>(formula).get_body(),
+			problem, required);
+		break;
+	case FORALL_F:
+		condition_literals(literals,
+			static_cast<const Forall&>(formula).get_universal_base(SubstitutionMap(),
+				problem), problem, required);
+		break;
+	default:
+		break;
+	}
+}
+
+
 // Construct a planning graph.
 PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 	: problem(&problem) {
@@ -584,7 +861,7 @@ PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 		for (GroundActionList::const_iterator ai = actions.begin();
 			ai != actions.end(); ai++) {
 			const GroundAction& action = **ai;
-			const Value* min_v = dynamic_cast<const Value*>(&action.get_min_duration());
+			const Value* min_v = action.get_min_duration_value();
 			if (min_v == NULL) {
 				throw runtime_error("non-constant minimum duration");
 			}
@@ -630,18 +907,18 @@ PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 		}
 	}
 
-	// Add initial conditions at level 0.
+	// Add initial conditions and timed initial literals.
+	LiteralAchieverMap literal_achievers;
 	const GroundAction& ia = problem.get_init_action();
 	for (EffectList::const_iterator ei = ia.get_effects().begin();
 		ei != ia.get_effects().end(); ei++) {
 		const Atom& atom = dynamic_cast<const Atom&>((*ei)->get_literal());
-		achievers[&atom].insert(make_pair(&ia, *ei));
+		literal_achievers[&atom].insert(make_pair(&ia, *ei));
 		if (PredicateTable::is_static(atom.get_predicate())) {
-			atom_values.insert(make_pair(&atom, HeuristicValue::ZERO));
+			set_value(atom_values, atom, HeuristicValue::ZERO);
 		}
 		else {
-			atom_values.insert(make_pair(&atom,
-				HeuristicValue::ZERO_COST_UNIT_WORK));
+			set_value(atom_values, atom, HeuristicValue::ZERO_COST_UNIT_WORK);
 		}
 	}
 	for (TimedActionTable::const_iterator ai = problem.get_timed_actions().begin();
@@ -651,7 +928,7 @@ PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 		for (EffectList::const_iterator ei = action.get_effects().begin();
 			ei != action.get_effects().end(); ei++) {
 			const Literal& literal = (*ei)->get_literal();
-			achievers[&literal].insert(make_pair(&action, *ei));
+			literal_achievers[&literal].insert(make_pair(&action, *ei));
 			float d = (params.action_cost == Parameters::UNIT_COST) ? 1.0f : time;
 			map<const Literal*, float>::const_iterator di =
 				duration_factor.find(&literal);
@@ -660,25 +937,110 @@ PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 			}
 			const Atom* atom = dynamic_cast<const Atom*>(&literal);
 			if (atom != NULL) {
-				if (atom_values.find(atom) == atom_values.end()) {
-					atom_values.insert(make_pair(atom,
-						HeuristicValue(d, 1, time)));
+				if (find_value(atom_values, *atom).is_infinite()) {
+					set_value(atom_values, *atom, HeuristicValue(d, 1, time));
 				}
 			}
 			else {
 				const Negation& negation = dynamic_cast<const Negation&>(literal);
-				if (negation_values.find(&negation.get_atom()) == negation_values.end()
+				if (find_value(negation_values, negation.get_atom()).is_infinite()
 					&& heuristic_value(negation.get_atom(), 0).is_zero()) {
-					negation_values.insert(make_pair(&negation.get_atom(),
-						HeuristicValue(d, 1, time)));
+					set_value(negation_values, negation.get_atom(),
+						HeuristicValue(d, 1, time));
 				}
 			}
 		}
 	}
 
-	// Generate the rest of the levels until no change occurs.
-	bool changed;
-	int level = 0;
+	// Find the literals in the conditions of each action.  An action is
+	// applied once every literal required by its start condition has a
+	// value, and again whenever one of its condition literals gets a lower
+	// value.  Negated atoms that do not hold initially have a constant value
+	// under the closed world assumption, so they are not tracked.
+	vector<size_t> pending(actions.size(), 0);
+	vector<vector<pair<size_t, bool> > > atom_triggers;
+	vector<vector<pair<size_t, bool> > > negation_triggers;
+	for (size_t i = 0; i < actions.size(); i++) {
+		const GroundAction& action = *actions[i];
+		map<const Literal*, bool> literals;
+		condition_literals(literals, action.get_condition(), problem, true);
+		for (EffectList::const_iterator ei = action.get_effects().begin();
+			ei != action.get_effects().end(); ei++) {
+			condition_literals(literals, (*ei)->get_condition(), problem, false);
+		}
+		for (map<const Literal*, bool>::const_iterator li = literals.begin();
+			li != literals.end(); li++) {
+			const Atom& atom = (*li).first->get_atom();
+			vector<vector<pair<size_t, bool> > >* triggers = &atom_triggers;
+			if ((*li).first != &atom) {
+				if (!heuristic_value(atom, 0).is_zero()) {
+					continue;
+				}
+				triggers = &negation_triggers;
+			}
+			if (atom.get_id() >= triggers->size()) {
+				triggers->resize(atom.get_id() + 1);
+			}
+			(*triggers)[atom.get_id()].push_back(make_pair(i, (*li).second));
+			if ((*li).second) {
+				pending[i]++;
+			}
+		}
+	}
+
+	// Propagate values from the initial conditions until no value changes,
+	// lowest value first, so that most literals are settled by the first
+	// event for them.
+	vector<ValueEvent> events;
+	for (size_t id = 0; id < value_atoms.size(); id++) {
+		if (value_atoms[id] != NULL) {
+			const HeuristicValue& value = find_value(atom_values, *value_atoms[id]);
+			if (!value.is_infinite()) {
+				events.push_back(ValueEvent(value, id, false));
+			}
+			const HeuristicValue& neg_value =
+				find_value(negation_values, *value_atoms[id]);
+			if (!neg_value.is_infinite()) {
+				events.push_back(ValueEvent(neg_value, id, true));
+			}
+		}
+	}
+	make_heap(events.begin(), events.end(), ValueEventOrder());
+	for (size_t i = 0; i < actions.size(); i++) {
+		if (pending[i] == 0) {
+			apply_action(*actions[i], params, duration_factor, events);
+		}
+	}
+	vector<bool> atom_reached(atom_triggers.size(), false);
+	vector<bool> negation_reached(negation_triggers.size(), false);
+	while (!events.empty()) {
+		pop_heap(events.begin(), events.end(), ValueEventOrder());
+		ValueEvent event = events.back();
+		events.pop_back();
+		const vector<HeuristicValue>& values =
+			event.negated ? negation_values : atom_values;
+		const vector<vector<pair<size_t, bool> > >& triggers =
+			event.negated ? negation_triggers : atom_triggers;
+		vector<bool>& reached = event.negated ? negation_reached : atom_reached;
+		if (values[event.id] != event.value || event.id >= triggers.size()) {
+			// The value has been lowered again since this event was queued.
+			continue;
+		}
+		bool first = !reached[event.id];
+		reached[event.id] = true;
+		const vector<pair<size_t, bool> >& tl = triggers[event.id];
+		for (vector<pair<size_t, bool> >::const_iterator ti = tl.begin();
+			ti != tl.end(); ti++) {
+			size_t i = (*ti).first;
+			if (first && (*ti).second) {
+				pending[i]--;
+			}
+			if (pending[i] == 0) {
+				apply_action(*actions[i], params, duration_factor, events);
+			}
+		}
+	}
+
 	//
 	// Keep track of both applicable and useful actions.  When planning
 	// with durative actions, it is possible that there are useful
@@ -689,181 +1051,68 @@ PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 
 	GroundActionSet applicable_actions;
 	GroundActionSet useful_actions;
-	do {
-		if (verbosity > 3) {
-			// Print literal values at this level.
-			cerr << "Literal values at level " << level << ":" << endl;
-			for (AtomValueMap::const_iterator vi = atom_values.begin();
-				vi != atom_values.end(); vi++) {
-				cerr << "  ";
-				(*vi).first->print(cerr, 0, Bindings::EMPTY);
-				cerr << " -- " << (*vi).second << endl;
-			}
-			for (AtomValueMap::const_iterator vi = negation_values.begin();
-				vi != negation_values.end(); vi++) {
-				cerr << "  (not ";
-				(*vi).first->print(cerr, 0, Bindings::EMPTY);
-				cerr << ") -- " << (*vi).second << endl;
-			}
+	for (size_t i = 0; i < actions.size(); i++) {
+		if (pending[i] > 0) {
+			continue;
 		}
-		level++;
-		changed = false;
-
-		// Find applicable actions at current level and add effects to the next level.
-		AtomValueMap new_atom_values;
-		AtomValueMap new_negation_values;
-		for (GroundActionList::const_iterator ai = actions.begin();
-			ai != actions.end(); ai++) {
-			const GroundAction& action = **ai;
-			HeuristicValue pre_value;
-			HeuristicValue start_value;
-			action.get_condition().get_heuristic_value(pre_value, start_value, *this, 0);
-			if (!start_value.is_infinite()) {
-				// Precondition is achievable at this level.
-				if (!pre_value.is_infinite()
-					&& applicable_actions.find(&action) == applicable_actions.end()) {
-					// First time this action is applicable.
-					applicable_actions.insert(&action);
-				}
-				for (EffectList::const_iterator ei = action.get_effects().begin();
-					ei != action.get_effects().end(); ei++) {
-					const Effect& effect = **ei;
-					if (effect.get_when() == EffectTime::AT_END && pre_value.is_infinite()) {
-						continue;
-					}
-					HeuristicValue cond_value, cond_value_start;
-					effect.get_condition().get_heuristic_value(cond_value, cond_value_start,
-						*this, 0);
-					if (!cond_value.is_infinite()
-						&& !effect.get_link_condition().is_contradiction()) {
-						// Effect condition is achievable at this level.
-						if (effect.get_when() == EffectTime::AT_START) {
-							cond_value += start_value;
-						}
-						else {
-							cond_value += pre_value;
-						}
-						const Value* min_v =
-							dynamic_cast<const Value*>(&action.get_min_duration());
-						if (min_v == NULL) {
-							throw runtime_error("non-constant minimum duration");
-						}
-						cond_value.increase_makespan(Orderings::threshold
-							+ min_v->get_value());
-
-						// Update heuristic values of literal added by effect.
-						const Literal& literal = effect.get_literal();
-						float d = ((params.action_cost == Parameters::UNIT_COST)
-							? 1.0f : Orderings::threshold + min_v->get_value());
-						map<const Literal*, float>::const_iterator di =
-							duration_factor.find(&literal);
-						if (di != duration_factor.end()) {
-							d /= (*di).second;
-						}
-						cond_value.increase_cost(d);
-						if (!find(achievers, literal, action, effect)) {
-							if (!pre_value.is_infinite()) {
-								achievers[&literal].insert(make_pair(&action, &effect));
-							}
-							if (useful_actions.find(&action) == useful_actions.end()) {
-								useful_actions.insert(&action);
-							}
-							if (verbosity > 4) {
-								cerr << "  ";
-								action.print(cerr, 0, Bindings::EMPTY);
-								cerr << " achieves ";
-								literal.print(cerr, 0, Bindings::EMPTY);
-								cerr << " with ";
-								effect.print(cerr);
-								cerr << ' ' << cond_value << endl;
-							}
-						}
-						const Atom* atom = dynamic_cast<const Atom*>(&literal);
-						if (atom != NULL) {
-							AtomValueMap::const_iterator vi = new_atom_values.find(atom);
-							if (vi == new_atom_values.end()) {
-								vi = atom_values.find(atom);
-								if (vi == atom_values.end()) {
-									// First level this atom is achieved.
-									HeuristicValue new_value = cond_value;
-									new_value.increment_work();
-									new_atom_values.insert(make_pair(atom, new_value));
-									changed = true;
-									continue;
-								}
-							}
-							// This atom has been achieved earlier.
-							HeuristicValue old_value = (*vi).second;
-							HeuristicValue new_value = cond_value;
-							new_value.increment_work();
-							new_value = min(new_value, old_value);
-							if (new_value != old_value) {
-								new_atom_values[atom] = new_value;
-								changed = true;
-							}
-						}
-						else {
-							const Negation& negation =
-								dynamic_cast<const Negation&>(literal);
-							AtomValueMap::const_iterator vi =
-								new_negation_values.find(&negation.get_atom());
-							if (vi == new_negation_values.end()) {
-								vi = negation_values.find(&negation.get_atom());
-								if (vi == negation_values.end()) {
-									if (heuristic_value(negation.get_atom(), 0).is_zero()) {
-										// First level this negated atom is achieved.
-										HeuristicValue new_value = cond_value;
-										new_value.increment_work();
-										new_negation_values.insert(make_pair(&negation.get_atom(),
-											new_value));
-										changed = true;
-										continue;
-									}
-									else {
-										// Closed world assumption.
-										continue;
-									}
-								}
-							}
-							// This negated atom has been achieved earlier.
-							HeuristicValue old_value = (*vi).second;
-							HeuristicValue new_value = cond_value;
-							new_value.increment_work();
-							new_value = min(new_value, old_value);
-							if (new_value != old_value) {
-								new_negation_values[&negation.get_atom()] = new_value;
-								changed = true;
-							}
-						}
-					}
-				}
-			}
+		const GroundAction& action = *actions[i];
+		HeuristicValue pre_value;
+		HeuristicValue start_value;
+		action.get_condition().get_heuristic_value(pre_value, start_value, *this, 0);
+		if (start_value.is_infinite()) {
+			continue;
 		}
-
-		// Add achieved atoms to previously achieved atoms.
-		for (AtomValueMap::const_iterator vi = new_atom_values.begin();
-			vi != new_atom_values.end(); vi++) {
-			atom_values[(*vi).first] = (*vi).second;
+		if (!pre_value.is_infinite()) {
+			applicable_actions.insert(&action);
 		}
-		// Add achieved negated atoms to previously achieved negated atoms.
-		for (AtomValueMap::const_iterator vi = new_negation_values.begin();
-			vi != new_negation_values.end(); vi++) {
-			negation_values[(*vi).first] = (*vi).second;
+		for (EffectList::const_iterator ei = action.get_effects().begin();
+			ei != action.get_effects().end(); ei++) {
+			const Effect& effect = **ei;
+			HeuristicValue cond_value = effect_value(action, effect,
+				pre_value, start_value, params, duration_factor);
+			if (!cond_value.is_infinite()) {
+				const Literal& literal = effect.get_literal();
+				if (!pre_value.is_infinite()) {
+					literal_achievers[&literal].insert(make_pair(&action, &effect));
+				}
+				useful_actions.insert(&action);
+				if (verbosity > 4) {
+					cerr << "  ";
+					action.print(cerr, 0, Bindings::EMPTY);
+					cerr << " achieves ";
+					literal.print(cerr, 0, Bindings::EMPTY);
+					cerr << " with ";
+					effect.print(cerr);
+					cerr << ' ' << cond_value << endl;
+				}
+			}
 		}
-	} while (changed);
+	}
 
-	// Map predicates to achievable ground atoms.
-	for (AtomValueMap::const_iterator vi = atom_values.begin();
-		vi != atom_values.end(); vi++) {
-		const Atom& atom = *(*vi).first;
-		predicate_atoms.insert(make_pair(atom.get_predicate(), &atom));
+	// Store the achievers of all literals in a table indexed by literal id.
+	for (LiteralAchieverMap::const_iterator lai = literal_achievers.begin();
+		lai != literal_achievers.end(); lai++) {
+		achievers.add((*lai).first->get_id(), (*lai).second);
 	}
 
-	// Map predicates to achievable negated ground atoms.
-	for (AtomValueMap::const_iterator vi = negation_values.begin();
-		vi != negation_values.end(); vi++) {
-		const Atom& atom = *(*vi).first;
-		predicate_negations.insert(make_pair(atom.get_predicate(), &atom));
+	// Map predicates to achievable ground atoms and negated ground atoms.
+	atom_values.resize(value_atoms.size(), HeuristicValue::INFINITE);
+	negation_values.resize(value_atoms.size(), HeuristicValue::INFINITE);
+	for (size_t id = 0; id < value_atoms.size(); id++) {
+		const Atom* atom = value_atoms[id];
+		if (atom != NULL) {
+			size_t p = atom->get_predicate().get_index();
+			if (p >= predicate_atoms.size()) {
+				predicate_atoms.resize(p + 1);
+				predicate_negations.resize(p + 1);
+			}
+			if (!atom_values[id].is_infinite()) {
+				predicate_atoms[p].add(*atom, atom_values[id]);
+			}
+			if (!negation_values[id].is_infinite()) {
+				predicate_negations[p].add(*atom, atom_values[id]);
+			}
+		}
 	}
 
 	// Collect actions that are both applicable and useful.  Create actions domains constraints for these actions, if called for.
@@ -919,18 +1168,7 @@ PlanningGraph::PlanningGraph(const Problem& problem, const Parameters& params)
 		}
 		// Print literal values.
 		cerr << "Achievable literals:" << endl;
-		for (AtomValueMap::const_iterator vi = atom_values.begin();
-			vi != atom_values.end(); vi++) {
-			cerr << "  ";
-			(*vi).first->print(cerr, 0, Bindings::EMPTY);
-			cerr << " -- " << (*vi).second << endl;
-		}
-		for (AtomValueMap::const_iterator vi = negation_values.begin();
-			vi != negation_values.end(); vi++) {
-			cerr << "  (not ";
-			(*vi).first->print(cerr, 0, Bindings::EMPTY);
-			cerr << ") -- " << (*vi).second << endl;
-		}
+		print_values(cerr);
 	}
 }
 
@@ -942,13 +1180,11 @@ PlanningGraph::~PlanningGraph() {
 		ActionDomain::unregister_use((*di).second);
 	}
 	GroundActionSet useful_actions;
-	for (LiteralAchieverMap::const_iterator lai = achievers.begin();
-		lai != achievers.end(); lai++) {
-		for (ActionEffectMap::const_iterator aei = (*lai).second.begin();
-			aei != (*lai).second.end(); aei++) {
-			if ((*aei).first->get_name().substr(0, 1) != "<") {
-				useful_actions.insert(dynamic_cast<const GroundAction*>((*aei).first));
-			}
+	const vector<ActionEffect>& all_achievers = achievers.get_achievers();
+	for (vector<ActionEffect>::const_iterator aei = all_achievers.begin();
+		aei != all_achievers.end(); aei++) {
+		if (!(*aei).first->is_pseudo()) {
+			useful_actions.insert(dynamic_cast<const GroundAction*>((*aei).first));
 		}
 	}
 	for (GroundActionSet::const_iterator ai = useful_actions.begin();
@@ -963,28 +1199,14 @@ HeuristicValue PlanningGraph::heuristic_value(const Atom& atom, size_t step_id,
 	const Bindings* bindings) const {
 	if (bindings == NULL) {
 		// Assume ground atom.
-		AtomValueMap::const_iterator vi = atom_values.find(&atom);
-		return ((vi != atom_values.end())
-			? (*vi).second : HeuristicValue::INFINITE);
+		return find_value(atom_values, atom);
 	}
 	else {
 		// Take minimum value of ground atoms that unify.
-		HeuristicValue value = HeuristicValue::INFINITE;
-		pair<PredicateAtomsMap::const_iterator,
-			PredicateAtomsMap::const_iterator> bounds =
-			predicate_atoms.equal_range(atom.get_predicate());
-		for (PredicateAtomsMap::const_iterator gi = bounds.first;
-			gi != bounds.second; gi++) {
-			const Atom& a = *(*gi).second;
-			if (bindings->unify(atom, step_id, a, 0)) {
-				HeuristicValue v = heuristic_value(a, 0);
-				value = min(value, v);
-				if (value.is_zero()) {
-					return value;
-				}
-			}
-		}
-		return value;
+		size_t p = atom.get_predicate().get_index();
+		return ((p < predicate_atoms.size())
+			? predicate_atoms[p].find_min(atom, step_id, *bindings)
+			: HeuristicValue::INFINITE);
 	}
 }
 
@@ -995,13 +1217,12 @@ HeuristicValue PlanningGraph::heuristic_value(const Negation& negation,
 	const Bindings* bindings) const {
 	if (bindings == NULL) {
 		// Assume ground negated atom.
-		AtomValueMap::const_iterator vi = negation_values.find(&negation.get_atom());
-		if (vi != negation_values.end()) {
-			return (*vi).second;
+		const HeuristicValue& value = find_value(negation_values, negation.get_atom());
+		if (!value.is_infinite()) {
+			return value;
 		}
 		else {
-			vi = atom_values.find(&negation.get_atom());
-			return ((vi == atom_values.end() || !(*vi).second.is_zero())
+			return (!find_value(atom_values, negation.get_atom()).is_zero()
 				? HeuristicValue::ZERO_COST_UNIT_WORK
 				: HeuristicValue::INFINITE);
 		}
@@ -1012,31 +1233,47 @@ HeuristicValue PlanningGraph::heuristic_value(const Negation& negation,
 		if (!heuristic_value(atom, step_id, bindings).is_zero()) {
 			return HeuristicValue::ZERO;
 		}
-		HeuristicValue value = HeuristicValue::INFINITE;
-		pair<PredicateAtomsMap::const_iterator,
-			PredicateAtomsMap::const_iterator> bounds =
-			predicate_negations.equal_range(negation.get_predicate());
-		for (PredicateAtomsMap::const_iterator gi = bounds.first;
-			gi != bounds.second; gi++) {
-			const Atom& a = *(*gi).second;
-			if (bindings->unify(atom, step_id, a, 0)) {
-				HeuristicValue v = heuristic_value(a, 0);
-				value = min(value, v);
-				if (value.is_zero()) {
-					return value;
-				}
-			}
-		}
-		return value;
+		size_t p = negation.get_predicate().get_index();
+		return ((p < predicate_negations.size())
+			? predicate_negations[p].find_min(atom, step_id, *bindings)
+			: HeuristicValue::INFINITE);
 	}
 }
 
 
-// Return a set of achievers for the given literal.
-const ActionEffectMap*
-PlanningGraph::literal_achievers(const Literal& literal) const {
-	LiteralAchieverMap::const_iterator lai = achievers.find(&literal);
-	return (lai != achievers.end()) ? &(*lai).second : NULL;
+// Set the value of the given atom in the given value table.
+void PlanningGraph::set_value(vector<HeuristicValue>& values, const Atom& atom,
+	const HeuristicValue& value) {
+	size_t id = atom.get_id();
+	if (id >= values.size()) {
+		values.resize(id + 1, HeuristicValue::INFINITE);
+	}
+	values[id] = value;
+	if (id >= value_atoms.size()) {
+		value_atoms.resize(id + 1, NULL);
+	}
+	value_atoms[id] = &atom;
+}
+
+
+// Print the values of all atoms and negated atoms on the given stream.
+void PlanningGraph::print_values(ostream& os) const {
+	for (size_t id = 0; id < value_atoms.size(); id++) {
+		if (value_atoms[id] != NULL
+			&& !find_value(atom_values, *value_atoms[id]).is_infinite()) {
+			os << "  ";
+			value_atoms[id]->print(os, 0, Bindings::EMPTY);
+			os << " -- " << atom_values[id] << endl;
+		}
+	}
+	for (size_t id = 0; id < value_atoms.size(); id++) {
+		if (value_atoms[id] != NULL
+			&& !find_value(negation_values, *value_atoms[id]).is_infinite()) {
+			os << "  (not ";
+			value_atoms[id]->print(os, 0, Bindings::EMPTY);
+			os << ") -- " << negation_values[id] << endl;
+		}
+	}
 }
 
 
@@ -1048,22 +1285,88 @@ PlanningGraph::action_domain(const string& name) const {
 }
 
 
-// Finds an element in a LiteralActionsMap.
-bool PlanningGraph::find(const PlanningGraph::LiteralAchieverMap& m,
-	const Literal &l, const Action& a,
-	const Effect& e) const {
-	LiteralAchieverMap::const_iterator lai = m.find(&l);
-	if (lai != m.end()) {
-		pair<ActionEffectMap::const_iterator,
-			ActionEffectMap::const_iterator> bounds = (*lai).second.equal_range(&a);
-		for (ActionEffectMap::const_iterator i = bounds.first;
-			i != bounds.second; i++) {
-			if ((*i).second == &e) {
-				return true;
+// Lower the value of the given atom in the given value table to the given value, and queue an event if the value changes.
+void PlanningGraph::improve_value(vector<HeuristicValue>& values,
+	const Atom& atom, bool negated, const HeuristicValue& value,
+	vector<ValueEvent>& events) {
+	HeuristicValue old_value = find_value(values, atom);
+	HeuristicValue new_value = min(value, old_value);
+	if (new_value != old_value) {
+		set_value(values, atom, new_value);
+		events.push_back(ValueEvent(new_value, atom.get_id(), negated));
+		push_heap(events.begin(), events.end(), ValueEventOrder());
+	}
+}
+
+
+// Return the value of the literal of the given effect of the given action, given the values of the action condition; infinite if the effect cannot be achieved.
+HeuristicValue PlanningGraph::effect_value(const GroundAction& action,
+	const Effect& effect,
+	const HeuristicValue& pre_value, const HeuristicValue& start_value,
+	const Parameters& params,
+	const map<const Literal*, float>& duration_factor) const {
+	if (effect.get_when() == EffectTime::AT_END && pre_value.is_infinite()) {
+		return HeuristicValue::INFINITE;
+	}
+	HeuristicValue cond_value, cond_value_start;
+	effect.get_condition().get_heuristic_value(cond_value, cond_value_start,
+		*this, 0);
+	if (cond_value.is_infinite()
+		|| effect.get_link_condition().is_contradiction()) {
+		return HeuristicValue::INFINITE;
+	}
+	if (effect.get_when() == EffectTime::AT_START) {
+		cond_value += start_value;
+	}
+	else {
+		cond_value += pre_value;
+	}
+	const Value* min_v = action.get_min_duration_value();
+	if (min_v == NULL) {
+		throw runtime_error("non-constant minimum duration");
+	}
+	cond_value.increase_makespan(Orderings::threshold + min_v->get_value());
+	float d = ((params.action_cost == Parameters::UNIT_COST)
+		? 1.0f : Orderings::threshold + min_v->get_value());
+	map<const Literal*, float>::const_iterator di =
+		duration_factor.find(&effect.get_literal());
+	if (di != duration_factor.end()) {
+		d /= (*di).second;
+	}
+	cond_value.increase_cost(d);
+	return cond_value;
+}
+
+
+// Lower the values of the literals achieved by the given action to the values given by the current values of its conditions.
+void PlanningGraph::apply_action(const GroundAction& action,
+	const Parameters& params,
+	const map<const Literal*, float>& duration_factor,
+	vector<ValueEvent>& events) {
+	HeuristicValue pre_value;
+	HeuristicValue start_value;
+	action.get_condition().get_heuristic_value(pre_value, start_value, *this, 0);
+	if (start_value.is_infinite()) {
+		return;
+	}
+	for (EffectList::const_iterator ei = action.get_effects().begin();
+		ei != action.get_effects().end(); ei++) {
+		const Effect& effect = **ei;
+		HeuristicValue value = effect_value(action, effect,
+			pre_value, start_value, params, duration_factor);
+		if (!value.is_infinite()) {
+			value.increment_work();
+			const Literal& literal = effect.get_literal();
+			const Atom& atom = literal.get_atom();
+			if (&literal == &atom) {
+				improve_value(atom_values, atom, false, value, events);
+			}
+			else if (heuristic_value(atom, 0).is_zero()) {
+				improve_value(negation_values, atom, true, value, events);
 			}
+			// Otherwise the negated atom holds by the closed world assumption.
 		}
 	}
-	return false;
 }
 
 
@@ -1589,9 +1892,9 @@ int FlawSelectionOrder::select_unsafe(FlawSelection& selection,
 		return numeric_limits<int>::max();
 	}
 	// Loop through usafes.
-	for (const Chain<Unsafe>* uc = plan.get_unsafes();
-		uc != NULL && first_criterion <= last_criterion; uc = uc->tail) {
-		const Unsafe& unsafe = uc->head;
+	for (FlawSet<Unsafe>::const_iterator ui(plan.get_unsafes());
+		!ui.at_end() && first_criterion <= last_criterion; ++ui) {
+		const Unsafe& unsafe = *ui;
 		if (verbosity > 1) {
 			cerr << "(considering ";
 			unsafe.print(cerr, Bindings::EMPTY);
@@ -1719,9 +2022,9 @@ int FlawSelectionOrder::select_open_cond(FlawSelection& selection,
 	}
 	size_t local_id = 0;
 	// Loop through open conditions.
-	for (const Chain<OpenCondition>* occ = plan.get_open_conds();
-		occ != NULL && first_criterion <= last_criterion; occ = occ->tail) {
-		const OpenCondition& open_cond = occ->head;
+	for (FlawSet<OpenCondition>::const_iterator oi(plan.get_open_conds());
+		!oi.at_end() && first_criterion <= last_criterion; ++oi) {
+		const OpenCondition& open_cond = *oi;
 		if (verbosity > 1) {
 			cerr << "(considering ";
 			open_cond.print(cerr, Bindings::EMPTY);
@@ -1902,8 +2205,7 @@ int FlawSelectionOrder::select_open_cond(FlawSelection& selection,
 					case SelectionCriterion::LC:
 					{
 						HeuristicValue h, hs;
-						formula_value(h, hs, open_cond.get_condition(), open_cond.get_step_id(),
-							plan, *pg, criterion.reuse);
+						open_condition_value(h, hs, open_cond, plan, *pg, criterion.reuse);
 						float rank = ((criterion.heuristic == SelectionCriterion::ADD)
 							? h.get_add_cost() : h.get_makespan());
 						if (c < selection.criterion || rank < selection.rank) {
@@ -1923,8 +2225,7 @@ int FlawSelectionOrder::select_open_cond(FlawSelection& selection,
 					case SelectionCriterion::MC:
 					{
 						HeuristicValue h, hs;
-						formula_value(h, hs, open_cond.get_condition(), open_cond.get_step_id(),
-							plan, *pg, criterion.reuse);
+						open_condition_value(h, hs, open_cond, plan, *pg, criterion.reuse);
 						float rank = ((criterion.heuristic == SelectionCriterion::ADD)
 							? h.get_add_cost() : h.get_makespan() + 0.5);
 						if (c < selection.criterion || rank > selection.rank) {
@@ -1944,8 +2245,7 @@ int FlawSelectionOrder::select_open_cond(FlawSelection& selection,
 					case SelectionCriterion::LW:
 					{
 						HeuristicValue h, hs;
-						formula_value(h, hs, open_cond.get_condition(), open_cond.get_step_id(),
-							plan, *pg, criterion.reuse);
+						open_condition_value(h, hs, open_cond, plan, *pg, criterion.reuse);
 						int rank = h.get_add_work();
 						if (c < selection.criterion || rank < selection.rank) {
 							selection.flaw = &open_cond;
@@ -1964,8 +2264,7 @@ int FlawSelectionOrder::select_open_cond(FlawSelection& selection,
 					case SelectionCriterion::MW:
 					{
 						HeuristicValue h, hs;
-						formula_value(h, hs, open_cond.get_condition(), open_cond.get_step_id(),
-							plan, *pg, criterion.reuse);
+						open_condition_value(h, hs, open_cond, plan, *pg, criterion.reuse);
 						int rank = h.get_add_work();
 						if (c < selection.criterion || rank > selection.rank) {
 							selection.flaw = &open_cond;
@@ -2006,6 +2305,6 @@ const Flaw& FlawSelectionOrder::select(const Plan& plan,
 		return *selection.flaw;
 	}
 	else {
-		return plan.get_mutex_threats()->head;
+		return plan.get_mutex_threats()->newest();
 	}
 }
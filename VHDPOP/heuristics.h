@@ -2,6 +2,7 @@
 
 #include "domains.h"
 #include "formulas.h"
+#include <atomic>
 #include <stdexcept>
 
 class Action;
@@ -74,46 +75,132 @@ public:
 // diff here
 
 
+// =================== AtomIndex ======================
+
+// An index of the ground atoms of a predicate by the objects at their
+// argument positions.  The lowest value of the atoms matching each pattern
+// of bound arguments is cached, so that a search for the lowest value of
+// the atoms that unify with a lifted atom can stop as soon as it is found.
+// Cached values are published in maps that never change once published,
+// so a cache hit takes no lock.
+class AtomIndex {
+	// Mapping of objects to positions of atoms in this index.
+	class ObjectAtomsMap : public map<int, vector<size_t> > {
+	};
+
+	// Mapping of patterns of bound arguments to lowest values.
+	class PatternValueMap : public map<vector<int>, HeuristicValue> {
+	};
+
+	// Atoms of this index, in order of id.
+	vector<const Atom*> atoms;
+	// Values of the atoms of this index.
+	vector<HeuristicValue> values;
+	// Positions of the atoms with each object at each argument position.
+	vector<ObjectAtomsMap> postings;
+	// Lowest values of the atoms matching patterns of bound arguments, as last published.
+	mutable atomic<const PatternValueMap*> published_values;
+	// Lowest values found since the last publication; the pattern lock must be held.
+	mutable PatternValueMap pending_values;
+	// Published maps that have been replaced, which readers may still hold until this index is destroyed.
+	mutable vector<const PatternValueMap*> retired_values;
+
+	// Return the positions of the atoms with the given object at the given argument position, or NULL if there are none.
+	const vector<size_t>* find_postings(size_t position, int object) const;
+
+	// Check if the given atom has the objects of the given pattern.
+	static bool matches(const Atom& atom, const vector<int>& pattern);
+
+	// Return the lowest value of the atoms matching the given pattern, which are among the given candidates.
+	HeuristicValue pattern_value(const vector<int>& pattern,
+		const vector<size_t>* candidates) const;
+
+public:
+	// Construct an empty index.
+	AtomIndex() :published_values(0) {}
+
+	// Construct a copy of the given index without its cached values; indices are only copied while they are built.
+	AtomIndex(const AtomIndex& index)
+		:atoms(index.atoms), values(index.values), postings(index.postings),
+		published_values(0) {}
+
+	// Destruct this index.
+	~AtomIndex();
+
+	// Add the given atom with the given value to this index.
+	void add(const Atom& atom, const HeuristicValue& value);
+
+	// Return the lowest value of the atoms in this index that unify with the given atom, or an infinite value if there are none.
+	HeuristicValue find_min(const Atom& atom, size_t step_id,
+		const Bindings& bindings) const;
+};
+
+
 // =================== PlanningGraph ======================
 
 // A planning graph.
 class PlanningGraph {
 
-	// Atom value map.
-	class AtomValueMap : public map<const Atom*, HeuristicValue> {
-	};
-
-	// Mapping of literals to actions.
+	// Mapping of literals to actions, while the graph is built.
 	class LiteralAchieverMap
 		: public map<const Literal*, ActionEffectMap> {
 	};
 
-	// Mapping of predicate names to ground atoms.
-	class PredicateAtomsMap : public multimap<Predicate, const Atom*> {
-	};
-
 	// Mapping of action name to parameter domain.
 	class ActionDomainMap : public map<string, ActionDomain*> {
 	};
 
 	// Problem associated with this planning graph.
 	const Problem* problem;
-	// Atom values.
-	AtomValueMap atom_values;
-	// Negated atom values.
-	AtomValueMap negation_values;
-	// Maps formulas to actions that achieve those formulas.
-	LiteralAchieverMap achievers;
-	// Maps predicates to ground atoms.
-	PredicateAtomsMap predicate_atoms;
-	// Maps predicates to negated ground atoms.
-	PredicateAtomsMap predicate_negations;
+	// Atom values, indexed by atom id (infinite if the atom is not reachable).
+	vector<HeuristicValue> atom_values;
+	// Negated atom values, indexed by atom id (infinite if no action achieves the negation).
+	vector<HeuristicValue> negation_values;
+	// Atoms with a value or a negated value, indexed by atom id.
+	vector<const Atom*> value_atoms;
+	// Actions that achieve each ground literal, indexed by literal id.
+	AchieverTable achievers;
+	// Indices of the reachable ground atoms of each predicate, indexed by predicate.
+	vector<AtomIndex> predicate_atoms;
+	// Indices of the achievable negated ground atoms of each predicate, indexed by predicate.
+	vector<AtomIndex> predicate_negations;
 	// Maps action names to possible parameter lists.
 	ActionDomainMap action_domains;
 
-	// Find an element in a LiteralActionsMap.
-	bool find(const LiteralAchieverMap& m, const Literal& l,
-		const Action& a, const Effect& e) const;
+	// A literal whose value has been lowered, waiting to be propagated to the actions that it is a condition of.
+	struct ValueEvent;
+
+	// Heap order of value events, with the lowest value first.
+	struct ValueEventOrder;
+
+	// Return the value of the given atom in the given value table.
+	static const HeuristicValue& find_value(const vector<HeuristicValue>& values,
+		const Atom& atom) {
+		size_t id = atom.get_id();
+		return (id < values.size()) ? values[id] : HeuristicValue::INFINITE;
+	}
+
+	// Set the value of the given atom in the given value table.
+	void set_value(vector<HeuristicValue>& values, const Atom& atom,
+		const HeuristicValue& value);
+
+	// Print the values of all atoms and negated atoms on the given stream.
+	void print_values(ostream& os) const;
+
+	// Lower the value of the given atom in the given value table to the given value, and queue an event if the value changes.
+	void improve_value(vector<HeuristicValue>& values, const Atom& atom,
+		bool negated, const HeuristicValue& value, vector<ValueEvent>& events);
+
+	// Return the value of the literal of the given effect of the given action, given the values of the action condition; infinite if the effect cannot be achieved.
+	HeuristicValue effect_value(const GroundAction& action, const Effect& effect,
+		const HeuristicValue& pre_value, const HeuristicValue& start_value,
+		const Parameters& params,
+		const map<const Literal*, float>& duration_factor) const;
+
+	// Lower the values of the literals achieved by the given action to the values given by the current values of its conditions.
+	void apply_action(const GroundAction& action, const Parameters& params,
+		const map<const Literal*, float>& duration_factor,
+		vector<ValueEvent>& events);
 
 public:
 	// Construct a planning graph.
@@ -133,8 +220,10 @@ public:
 	HeuristicValue heuristic_value(const Negation& negation, size_t step_id,
 		const Bindings* bindings = NULL) const;
 
-	// Return a set of achievers for the given literal.
-	const ActionEffectMap* literal_achievers(const Literal& literal) const;
+	// Return the achievers for the given ground literal.
+	AchieverRange literal_achievers(const Literal& literal) const {
+		return achievers.find(literal.get_id());
+	}
 
 	// Return the parameter domain for the given action, or NULL if the parameter domain is empty.
 	const ActionDomain* action_domain(const string& name) const;
@@ -12,6 +12,9 @@
 // Minimum distance between two ordered steps.
 float Orderings::threshold = 0.01f;
 
+// Serial number of the next ordering collection to be created.
+std::atomic<size_t> Orderings::next_serial(1);
+
 // Output operator for orderings.
 ostream& operator<<(ostream& os, const Orderings& o) {
 	o.print(os);
@@ -30,7 +33,7 @@ float BinaryOrderings::schedule(map<size_t, float>& start_times,
 	}
 	else {
 		float sd = 1.0f;
-		size_t n = before.size() + 1;
+		size_t n = num_steps;
 		for (size_t j = 1; j <= n; j++) {
 			if (step_id != j && is_before(j, step_id)) {
 				float ed = 1.0f + schedule(start_times, end_times, j);
@@ -56,7 +59,7 @@ float BinaryOrderings::schedule(map<size_t, float>& start_times,
 	}
 	else {
 		float sd = threshold;
-		size_t n = before.size() + 1;
+		size_t n = num_steps;
 		for (size_t j = 1; j <= n; j++) {
 			if (step_id != j && is_before(j, step_id)) {
 				float ed = threshold + schedule(start_times, end_times, j, min_times);
@@ -83,61 +86,143 @@ float BinaryOrderings::schedule(map<size_t, float>& start_times,
 
 // Return true if the first step is ordered before the second step.
 bool BinaryOrderings::is_before(size_t id1, size_t id2) const {
-	if (id1 == id2) {
+	if (id1 == id2 || id1 > num_steps || id2 > num_steps) {
 		return false;
 	}
-	else if (id1 < id2) {
-		return (*before[id2 - 2])[id1 - 1];
-	}
 	else {
-		return (*before[id1 - 2])[2 * id1 - 2 - id2];
+		size_t bit = id2 - 1;
+		const BitChunk* chunk = chunks[(id1 - 1) * row_chunks + bit / BitChunk::BITS];
+		return chunk != NULL
+			&& ((chunk->words[(bit % BitChunk::BITS) / 64] >> (bit % 64)) & 1) != 0;
 	}
 }
 
-// Order the first step before the second step.
-void BinaryOrderings::set_before(map<size_t, BoolVector*>& own_data,
-	size_t id1, size_t id2) {
-	if (id1 != id2) {
-		size_t i = max(id1, id2) - 2;
-		BoolVector* bv;
-		map<size_t, BoolVector*>::const_iterator vi = own_data.find(i);
-		if (vi != own_data.end()) {
-			bv = (*vi).second;
-		}
-		else {
-			const BoolVector* old_bv = before[i];
-			bv = new BoolVector(*old_bv);
-			BoolVector::register_use(bv);
-			BoolVector::unregister_use(old_bv);
-			before[i] = bv;
-			own_data.insert(make_pair(i, bv));
-		}
-		if (id1 < id2) {
-			(*bv)[id1 - 1] = true;
-		}
-		else {
-			(*bv)[2 * id1 - 2 - id2] = true;
+// Extend the matrix to the given number of steps.
+void BinaryOrderings::add_steps(size_t n) {
+	if (n <= num_steps) {
+		return;
+	}
+	size_t new_row_chunks = (n + BitChunk::BITS - 1) / BitChunk::BITS;
+	if (new_row_chunks > row_chunks) {
+		// Widen the existing rows with chunks that have no bits set.
+		vector<const BitChunk*> wide_chunks(num_steps * new_row_chunks, NULL);
+		for (size_t i = 0; i < num_steps; i++) {
+			for (size_t c = 0; c < row_chunks; c++) {
+				wide_chunks[i * new_row_chunks + c] = chunks[i * row_chunks + c];
+			}
 		}
+		chunks.swap(wide_chunks);
+		row_chunks = new_row_chunks;
+	}
+	chunks.resize(n * row_chunks, NULL);
+	heights.resize(n, 1);
+	if (max_height < 1) {
+		max_height = 1;
+	}
+	num_steps = n;
+}
+
+// Set the given bits in the row of the given step; own_chunks holds the chunks already copied for writing.
+void BinaryOrderings::merge_row(vector<BitChunk*>& own_chunks, size_t id,
+	const vector<unsigned long long>& bits) {
+	for (size_t c = 0; c < row_chunks; c++) {
+		const unsigned long long* chunk_bits = &bits[c * BitChunk::WORDS];
+		size_t i = (id - 1) * row_chunks + c;
+		if (!BitChunk::adds_bits(chunks[i], chunk_bits)) {
+			continue;
+		}
+		BitChunk* chunk = own_chunks[i];
+		if (chunk == NULL) {
+			// Copy the chunk, which may be shared with other ordering collections.
+			chunk = (chunks[i] != NULL) ? new BitChunk(*chunks[i]) : new BitChunk();
+			ref(chunk);
+			destructive_deref(chunks[i]);
+			chunks[i] = chunk;
+			own_chunks[i] = chunk;
+		}
+		chunk->merge(chunk_bits);
 	}
 }
 
 // Update the transitive closure given a new ordering constraint.
-void BinaryOrderings::fill_transitive(map<size_t, BoolVector*>& own_data,
-	const Ordering& ordering) {
+void BinaryOrderings::fill_transitive(const Ordering& ordering) {
 	size_t i = ordering.get_before_id();
 	size_t j = ordering.get_after_id();
-	if (!is_before(i, j)) {
-		// Reordering
-		size_t n = before.size() + 1;
-		for (size_t k = 1; k <= n; k++) {
-			if ((k == i || is_before(k, i)) && !is_before(k, j)) {
-				for (size_t l = 1; l <= n; l++) {
-					if ((j == l || is_before(j, l)) && !is_before(k, l)) {
-						set_before(own_data, k, l);
+	add_steps(max(i, j));
+	if (i != j && !is_before(i, j)) {
+		// Step j and the steps after it, which become ordered after step i and every step before it.
+		vector<unsigned long long> after(row_chunks * BitChunk::WORDS, 0);
+		for (size_t c = 0; c < row_chunks; c++) {
+			const BitChunk* chunk = chunks[(j - 1) * row_chunks + c];
+			if (chunk != NULL) {
+				copy(chunk->words, chunk->words + BitChunk::WORDS,
+					after.begin() + c * BitChunk::WORDS);
+			}
+		}
+		after[(j - 1) / 64] |= 1ULL << ((j - 1) % 64);
+		vector<BitChunk*> own_chunks(chunks.size(), NULL);
+		// Step i and the steps before it, whose longest chains may now run through step j.
+		vector<size_t> raised;
+		for (size_t k = 1; k <= num_steps; k++) {
+			if (k == i || is_before(k, i)) {
+				if (!is_before(k, j)) {
+					// A step is never ordered before itself.
+					unsigned long long& word = after[(k - 1) / 64];
+					unsigned long long self = word & (1ULL << ((k - 1) % 64));
+					word &= ~self;
+					merge_row(own_chunks, k, after);
+					word |= self;
+				}
+				raised.push_back(k);
+			}
+		}
+		update_heights(raised);
+	}
+}
+
+// Order steps by increasing height.
+struct HeightOrder {
+	// Heights of the steps.
+	const vector<int>& heights;
+
+	// Construct an ordering on the given heights.
+	HeightOrder(const vector<int>& heights) :heights(heights) {}
+
+	// Check if the first step comes before the second step.
+	bool operator()(size_t id1, size_t id2) const {
+		return heights[id1 - 1] < heights[id2 - 1];
+	}
+};
+
+// Recompute the heights of the given steps, which hold every step whose height may have changed.
+void BinaryOrderings::update_heights(vector<size_t>& ids) {
+	// No ordering among the given steps is new, so their old heights
+	// order them with every step after the steps following it.
+	sort(ids.begin(), ids.end(), HeightOrder(heights));
+	for (vector<size_t>::const_iterator ii = ids.begin(); ii != ids.end(); ii++) {
+		size_t id = *ii;
+		int height = 1;
+		for (size_t c = 0; c < row_chunks; c++) {
+			const BitChunk* chunk = chunks[(id - 1) * row_chunks + c];
+			if (chunk == NULL) {
+				continue;
+			}
+			for (size_t w = 0; w < BitChunk::WORDS; w++) {
+				unsigned long long word = chunk->words[w];
+				for (size_t b = 0; word != 0; b++, word >>= 1) {
+					if ((word & 1) != 0) {
+						size_t after = c * BitChunk::BITS + w * 64 + b;
+						if (heights[after] + 1 > height) {
+							height = heights[after] + 1;
+						}
 					}
 				}
 			}
 		}
+		heights[id - 1] = height;
+		if (height > max_height) {
+			max_height = height;
+		}
 	}
 }
 
@@ -208,8 +293,7 @@ const BinaryOrderings* BinaryOrderings::refine(const Ordering& new_ordering) con
 			new_ordering.get_after_id(),
 			new_ordering.get_after_time())) {
 		BinaryOrderings& orderings = *new BinaryOrderings(*this);
-		map<size_t, BoolVector*> own_data;
-		orderings.fill_transitive(own_data, new_ordering);
+		orderings.fill_transitive(new_ordering);
 		return &orderings;
 	}
 	else {
@@ -222,18 +306,10 @@ const BinaryOrderings* BinaryOrderings::refine(const Ordering& new_ordering,
 	const Step& new_step, const PlanningGraph* pg, const Bindings* bindings) const {
 	if (new_step.get_id() != 0 && new_step.get_id() != Plan::GOAL_ID) {
 		BinaryOrderings& orderings = *new BinaryOrderings(*this);
-		map<size_t, BoolVector*> own_data;
-		if (new_step.get_id() > before.size() + 1) {
-			if (new_step.get_id() > 1) {
-				BoolVector* bv = new BoolVector(2 * new_step.get_id() - 2, false);
-				own_data.insert(make_pair(orderings.before.size(), bv));
-				orderings.before.push_back(bv);
-				BoolVector::register_use(bv);
-			}
-		}
+		orderings.add_steps(new_step.get_id());
 		if (new_ordering.get_before_id() != 0
 			&& new_ordering.get_after_id() != Plan::GOAL_ID) {
-			orderings.fill_transitive(own_data, new_ordering);
+			orderings.fill_transitive(new_ordering);
 		}
 		return &orderings;
 	}
@@ -246,7 +322,7 @@ const BinaryOrderings* BinaryOrderings::refine(const Ordering& new_ordering,
 float BinaryOrderings::schedule(map<size_t, float>& start_times,
 	map<size_t, float>& end_times) const {
 	float max_dist = 0.0f;
-	size_t n = before.size() + 1;
+	size_t n = num_steps;
 	for (size_t i = 1; i <= n; i++) {
 		float ed = schedule(start_times, end_times, i);
 		if (ed > max_dist) {
@@ -256,20 +332,32 @@ float BinaryOrderings::schedule(map<size_t, float>& start_times,
 	return max_dist;
 }
 
-// Return the makespan of this ordering collection.
+// Return the makespan of this ordering collection.  A step scheduled at
+// its minimum time pushes back the steps of the longest chain starting at
+// it, so only the steps with minimum times need to be visited besides the
+// cached length of the longest chain.
 float BinaryOrderings::makespan(const map<pair<size_t,
 	StepTime::StepPoint>, float>& min_times) const {
-	map<size_t, float> start_times, end_times;
-	float max_dist = 0.0f;
-	size_t n = before.size() + 1;
-	for (size_t i = 1; i <= n; i++) {
-		float ed = schedule(start_times, end_times, i, min_times);
-		if (ed > max_dist) {
-			max_dist = ed;
+	float max_dist = threshold * max_height;
+	map<pair<size_t, StepTime::StepPoint>, float>::const_iterator md;
+	for (md = min_times.begin(); md != min_times.end(); md++) {
+		size_t id = (*md).first.first;
+		// Use the start time of a step if there is one, and the end time otherwise.
+		if ((*md).first.second == StepTime::END && md != min_times.begin()) {
+			map<pair<size_t, StepTime::StepPoint>, float>::const_iterator prev = md;
+			prev--;
+			if ((*prev).first.first == id) {
+				continue;
+			}
+		}
+		if (id >= 1 && id <= num_steps) {
+			float sd = max(threshold, (*md).second) + threshold * (heights[id - 1] - 1);
+			if (sd > max_dist) {
+				max_dist = sd;
+			}
 		}
 	}
-	map<pair<size_t, StepTime::StepPoint>, float>::const_iterator md =
-		min_times.find(make_pair(Plan::GOAL_ID, StepTime::START));
+	md = min_times.find(make_pair(Plan::GOAL_ID, StepTime::START));
 	if (md != min_times.end()) {
 		if ((*md).second > max_dist) {
 			max_dist = (*md).second;
@@ -278,10 +366,34 @@ float BinaryOrderings::makespan(const map<pair<size_t,
 	return max_dist;
 }
 
+// Append the constraints between the given steps, taken in the given order, to the given plan signature.
+void BinaryOrderings::add_signature(vector<size_t>& sig,
+	const vector<size_t>& step_ids) const {
+	// Pack the ordering matrix into words, one bit per pair of steps.
+	const size_t word_bits = 8 * sizeof(size_t);
+	size_t word = 0;
+	size_t bits = 0;
+	for (vector<size_t>::const_iterator i = step_ids.begin();
+		i != step_ids.end(); i++) {
+		for (vector<size_t>::const_iterator j = step_ids.begin();
+			j != step_ids.end(); j++) {
+			word = (word << 1) | (is_before(*i, *j) ? 1 : 0);
+			if (++bits == word_bits) {
+				sig.push_back(word);
+				word = 0;
+				bits = 0;
+			}
+		}
+	}
+	if (bits > 0) {
+		sig.push_back(word);
+	}
+}
+
 // Print this object on the given stream.
 void BinaryOrderings::print(ostream& os) const {
 	os << "{";
-	size_t n = before.size() + 1;
+	size_t n = num_steps;
 	for (size_t i = 1; i <= n; i++) {
 		for (size_t j = 1; j <= n; j++) {
 			if (is_before(i, j)) {
@@ -298,60 +410,86 @@ int TemporalOrderings::get_distance(size_t t1, size_t t2) const {
 	if (t1 == t2) {
 		return 0;
 	}
-	else if (t1 < t2) {
-		return (*distance[t2 - 1])[t1];
-	}
-	else {
-		return (*distance[t1 - 1])[2 * t1 - 1 - t2];
-	}
+	const IntVector& row = *distance[t1];
+	return (t2 < row.size()) ? row[t2] : INT_MAX;
+}
+
+// Return the row of the given time node owned by this ordering collection, with at least the given number of columns.
+IntVector& TemporalOrderings::own_row(vector<IntVector*>& own_rows,
+	size_t t, size_t width) {
+	if (own_rows.size() < distance.size()) {
+		own_rows.resize(distance.size(), NULL);
+	}
+	IntVector* row = own_rows[t];
+	if (row == NULL) {
+		const IntVector* old_row = distance[t];
+		row = new IntVector(*old_row);
+		IntVector::register_use(row);
+		IntVector::unregister_use(old_row);
+		distance[t] = row;
+		own_rows[t] = row;
+	}
+	if (row->size() < width) {
+		row->resize(width, INT_MAX);
+	}
+	return *row;
 }
 
 // Set the maximum distance from the first and the second time node.
-void TemporalOrderings::set_distance(map<size_t, IntVector*>& own_data,
+void TemporalOrderings::set_distance(vector<IntVector*>& own_rows,
 	size_t t1, size_t t2, int d) {
 	if (t1 != t2) {
-		size_t i = max(t1, t2) - 1;
-		IntVector* fv;
-		map<size_t, IntVector*>::const_iterator vi = own_data.find(i);
-		if (vi != own_data.end()) {
-			fv = (*vi).second;
-		}
-		else {
-			const IntVector* old_fv = distance[i];
-			fv = new IntVector(*old_fv);
-			IntVector::register_use(fv);
-			IntVector::unregister_use(old_fv);
-			distance[i] = fv;
-			own_data.insert(make_pair(i, fv));
-		}
-		if (t1 < t2) {
-			(*fv)[t1] = d;
-		}
-		else {
-			(*fv)[2 * t1 - 1 - t2] = d;
+		own_row(own_rows, t1, t2 + 1)[t2] = d;
+		if (t2 == 0) {
+			update_goal_end(t1);
 		}
 	}
 }
 
-// Update the transitive closure given a new ordering constraint.
-bool TemporalOrderings::fill_transitive(map<size_t, IntVector*>& own_data,
+// Add unconstrained time nodes for the start and end of a new step.
+void TemporalOrderings::add_time_nodes(vector<IntVector*>& own_rows) {
+	for (int p = 0; p < 2; p++) {
+		size_t t = distance.size();
+		IntVector* row = new IntVector(t + 1, INT_MAX);
+		(*row)[t] = 0;
+		IntVector::register_use(row);
+		distance.push_back(row);
+		own_rows.resize(distance.size(), NULL);
+		own_rows[t] = row;
+	}
+}
+
+// Lower the distances in the given row to the distances through another time node, given the distance to that node and its row.
+static void min_plus(int* row, const int* via, size_t n, int d) {
+	// Kept free of early exits and dependencies between columns so that the loop can be vectorized.
+	for (size_t k = 0; k < n; k++) {
+		int through = (via[k] < INT_MAX) ? via[k] + d : INT_MAX;
+		row[k] = (through < row[k]) ? through : row[k];
+	}
+}
+
+// Update the minimal network given a new ordering constraint.  Since the
+// network is consistent and closed before the update, the constraint only
+// shortens paths that lead into the time node i through j, so only the rows
+// of time nodes whose distance to i shrinks are touched, each with a single
+// min-plus pass over the row of i.
+bool TemporalOrderings::fill_transitive(vector<IntVector*>& own_rows,
 	size_t i, size_t j, int dist) {
 	if (get_distance(j, i) > -dist) {
-		// Update the temporal constraints.
+		int d_ij = get_distance(i, j);
+		if (d_ij < INT_MAX && d_ij - dist < 0) {
+			// The constraint closes a negative cycle.
+			return false;
+		}
+		// The row of i itself is never affected, so it can be read while updating the others.
+		const IntVector& via = *distance[i];
 		size_t n = distance.size();
-		for (size_t k = 0; k <= n; k++) {
-			int d_ik = get_distance(i, k);
-			if (d_ik < INT_MAX && get_distance(j, k) > d_ik - dist) {
-				for (size_t l = 0; l <= n; l++) {
-					int d_lj = get_distance(l, j);
-					int new_d = d_ik + d_lj - dist;
-					if (d_lj < INT_MAX && get_distance(l, k) > new_d) {
-						set_distance(own_data, l, k, new_d);
-						if (-get_distance(k, l) > new_d) {
-							return false;
-						}
-					}
-				}
+		for (size_t l = 0; l < n; l++) {
+			int d_lj = get_distance(l, j);
+			if (d_lj < INT_MAX && get_distance(l, i) > d_lj - dist) {
+				IntVector& row = own_row(own_rows, l, via.size());
+				min_plus(&row[0], &via[0], via.size(), d_lj - dist);
+				update_goal_end(l);
 			}
 		}
 	}
@@ -468,9 +606,9 @@ const TemporalOrderings* TemporalOrderings::refine(size_t step_id,
 		}
 		else {
 			TemporalOrderings& orderings = *new TemporalOrderings(*this);
-			map<size_t, IntVector*> own_data;
-			if (orderings.fill_transitive(own_data, 0, i, start)
-				&& orderings.fill_transitive(own_data, 0, j, end)) {
+			vector<IntVector*> own_rows;
+			if (orderings.fill_transitive(own_rows, 0, i, start)
+				&& orderings.fill_transitive(own_rows, 0, j, end)) {
 				return &orderings;
 			}
 			else {
@@ -487,35 +625,30 @@ const TemporalOrderings* TemporalOrderings::refine(size_t step_id,
 // Return the ordering collection with the given additions.
 const TemporalOrderings* TemporalOrderings::refine(float time, const Step& new_step) const {
 	if (new_step.get_id() != 0 && new_step.get_id() != Plan::GOAL_ID
-		&& new_step.get_id() > distance.size() / 2) {
+		&& new_step.get_id() > num_steps()) {
 		int itime = int(time / threshold + 0.5);
 		TemporalOrderings& orderings = *new TemporalOrderings(*this);
-		IntVector* fv = new IntVector(4 * new_step.get_id() - 2, INT_MAX);
-		/* Time for start of new step. */
-		(*fv)[0] = itime;
-		(*fv)[4 * new_step.get_id() - 3] = -itime;
+		vector<IntVector*> own_rows;
+		orderings.add_time_nodes(own_rows);
+		size_t s = time_node(new_step.get_id(), StepTime::AT_START);
+		size_t e = time_node(new_step.get_id(), StepTime::AT_END);
+		/* Time for start and end of new step. */
+		orderings.set_distance(own_rows, 0, s, itime);
+		orderings.set_distance(own_rows, s, 0, -itime);
+		orderings.set_distance(own_rows, 0, e, itime);
+		orderings.set_distance(own_rows, e, 0, -itime);
 		for (size_t id = 1; id < new_step.get_id(); id++) {
-			int t = itime - (*distance[2 * id - 1])[0];
-			(*fv)[2 * id - 1] = (*fv)[2 * id] = t;
-			(*fv)[4 * new_step.get_id() - 2 * id - 2] = -t;
-			(*fv)[4 * new_step.get_id() - 2 * id - 3] = -t;
+			int t = itime - get_distance(0, time_node(id, StepTime::AT_END));
+			for (size_t k = 2 * id - 1; k <= 2 * id; k++) {
+				orderings.set_distance(own_rows, k, s, t);
+				orderings.set_distance(own_rows, k, e, t);
+				orderings.set_distance(own_rows, s, k, -t);
+				orderings.set_distance(own_rows, e, k, -t);
+			}
 			// ???
 		}
-		orderings.distance.push_back(fv);
-		IntVector::register_use(fv);
-		fv = new IntVector(4 * new_step.get_id(), INT_MAX);
-		/* Time for end of new step. */
-		(*fv)[0] = itime;
-		(*fv)[4 * new_step.get_id() - 1] = -itime;
-		for (size_t id = 1; id < new_step.get_id(); id++) {
-			int t = itime - (*distance[2 * id - 1])[0];
-			(*fv)[2 * id - 1] = (*fv)[2 * id] = t;
-			(*fv)[4 * new_step.get_id() - 2 * id] = -t;
-			(*fv)[4 * new_step.get_id() - 2 * id - 1] = -t;
-		}
-		(*fv)[2 * new_step.get_id() - 1] = (*fv)[2 * new_step.get_id()] = 0;
-		orderings.distance.push_back(fv);
-		IntVector::register_use(fv);
+		orderings.set_distance(own_rows, s, e, 0);
+		orderings.set_distance(own_rows, e, s, 0);
 		return &orderings;
 	}
 	else {
@@ -532,7 +665,7 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering)
 			new_ordering.get_after_id(),
 			new_ordering.get_after_time())) {
 		TemporalOrderings& orderings = *new TemporalOrderings(*this);
-		map<size_t, IntVector*> own_data;
+		vector<IntVector*> own_rows;
 		size_t i = time_node(new_ordering.get_before_id(), new_ordering.get_before_time());
 		size_t j = time_node(new_ordering.get_after_id(), new_ordering.get_after_time());
 		int dist;
@@ -542,7 +675,7 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering)
 		else {
 			dist = 1;
 		}
-		if (orderings.fill_transitive(own_data, i, j, dist)) {
+		if (orderings.fill_transitive(own_rows, i, j, dist)) {
 			return &orderings;
 		}
 		else {
@@ -560,15 +693,13 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering,
 	const Step& new_step, const PlanningGraph* pg, const Bindings* bindings) const {
 	if (new_step.get_id() != 0 && new_step.get_id() != Plan::GOAL_ID) {
 		TemporalOrderings& orderings = *new TemporalOrderings(*this);
-		map<size_t, IntVector*> own_data;
-		if (new_step.get_id() > distance.size() / 2) {
-			const Value* min_v =
-				dynamic_cast<const Value*>(&new_step.get_action().get_min_duration());
+		vector<IntVector*> own_rows;
+		if (new_step.get_id() > num_steps()) {
+			const Value* min_v = new_step.get_action().get_min_duration_value();
 			if (min_v == NULL) {
 				throw runtime_error("non-constant minimum duration");
 			}
-			const Value* max_v =
-				dynamic_cast<const Value*>(&new_step.get_action().get_max_duration());
+			const Value* max_v = new_step.get_action().get_max_duration_value();
 			if (max_v == NULL) {
 				throw runtime_error("non-constant maximum duration");
 			}
@@ -589,22 +720,16 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering,
 			else {
 				end_time = threshold + min_v->get_value();
 			}
-			IntVector* fv = new IntVector(4 * new_step.get_id() - 2, INT_MAX);
-			/* Earliest time for start of new step. */
-			(*fv)[4 * new_step.get_id() - 3] = -int(start_time / threshold + 0.5);
-			own_data.insert(make_pair(orderings.distance.size(), fv));
-			orderings.distance.push_back(fv);
-			IntVector::register_use(fv);
-			fv = new IntVector(4 * new_step.get_id(), INT_MAX);
-			/* Earliest time for end of new step. */
-			(*fv)[4 * new_step.get_id() - 1] = -int(end_time / threshold + 0.5);
+			orderings.add_time_nodes(own_rows);
+			size_t s = time_node(new_step.get_id(), StepTime::AT_START);
+			size_t e = time_node(new_step.get_id(), StepTime::AT_END);
+			/* Earliest time for start and end of new step. */
+			orderings.set_distance(own_rows, s, 0, -int(start_time / threshold + 0.5));
+			orderings.set_distance(own_rows, e, 0, -int(end_time / threshold + 0.5));
 			if (max_v->get_value() != numeric_limits<float>::infinity()) {
-				(*fv)[2 * new_step.get_id() - 1] = int(max_v->get_value() / threshold + 0.5);
+				orderings.set_distance(own_rows, s, e, int(max_v->get_value() / threshold + 0.5));
 			}
-			(*fv)[2 * new_step.get_id()] = -int(min_v->get_value() / threshold + 0.5);
-			own_data.insert(make_pair(orderings.distance.size(), fv));
-			orderings.distance.push_back(fv);
-			IntVector::register_use(fv);
+			orderings.set_distance(own_rows, e, s, -int(min_v->get_value() / threshold + 0.5));
 		}
 		if (new_ordering.get_before_id() != 0) {
 			if (new_ordering.get_after_id() != Plan::GOAL_ID) {
@@ -619,7 +744,7 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering,
 				else {
 					dist = 1;
 				}
-				if (orderings.fill_transitive(own_data, i, j, dist)) {
+				if (orderings.fill_transitive(own_rows, i, j, dist)) {
 					return &orderings;
 				}
 				else {
@@ -628,10 +753,12 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering,
 				}
 			}
 			else {
-				orderings.goal_achievers =
-					new Chain<size_t>(new_ordering.get_before_id(),
-						orderings.goal_achievers);
-				RCObject::ref(orderings.goal_achievers);
+				size_t id = new_ordering.get_before_id();
+				if (orderings.goal_achievers.size() <= id) {
+					orderings.goal_achievers.resize(id + 1, false);
+				}
+				orderings.goal_achievers[id] = true;
+				orderings.update_goal_end(time_node(id, StepTime::AT_END));
 			}
 		}
 		return &orderings;
@@ -645,14 +772,14 @@ const TemporalOrderings* TemporalOrderings::refine(const Ordering& new_ordering,
 float TemporalOrderings::schedule(map<size_t, float>& start_times,
 	map<size_t, float>& end_times) const {
 	float max_dist = 0.0f;
-	size_t n = distance.size() / 2;
+	size_t n = num_steps();
 	for (size_t i = 1; i <= n; i++) {
 		float sd = -get_distance(time_node(i, StepTime::AT_START), 0)*threshold;
 		start_times.insert(make_pair(i, sd));
 		float ed = -get_distance(time_node(i, StepTime::AT_END), 0)*threshold;
 		end_times.insert(make_pair(i, ed));
 		if (ed > max_dist
-			&& goal_achievers != NULL && goal_achievers->contains(i)) {
+			&& is_goal_achiever(i)) {
 			max_dist = ed;
 		}
 	}
@@ -662,24 +789,37 @@ float TemporalOrderings::schedule(map<size_t, float>& start_times,
 // Return the makespan of this ordering collection.
 float TemporalOrderings::makespan(const map<pair<size_t,
 	StepTime::StepPoint>, float>& min_times) const {
-	float max_dist = 0.0f;
-	size_t n = distance.size() / 2;
-	for (size_t i = 1; i <= n; i++) {
-		float ed = -get_distance(time_node(i, StepTime::AT_END), 0)*threshold;
-		if (ed > max_dist
-			&& goal_achievers != NULL && goal_achievers->contains(i)) {
-			max_dist = ed;
+	return goal_end*threshold;
+}
+
+// Append the constraints between the given steps, taken in the given order, to the given plan signature.
+void TemporalOrderings::add_signature(vector<size_t>& sig,
+	const vector<size_t>& step_ids) const {
+	// Time nodes in signature order, starting with the time origin.
+	vector<size_t> nodes(1, 0);
+	for (vector<size_t>::const_iterator si = step_ids.begin();
+		si != step_ids.end(); si++) {
+		nodes.push_back(time_node(*si, StepTime::AT_START));
+		nodes.push_back(time_node(*si, StepTime::AT_END));
+		sig.push_back(is_goal_achiever(*si) ? 1 : 0);
+	}
+	for (vector<size_t>::const_iterator i = nodes.begin();
+		i != nodes.end(); i++) {
+		for (vector<size_t>::const_iterator j = nodes.begin();
+			j != nodes.end(); j++) {
+			if (*i != *j) {
+				sig.push_back(size_t(get_distance(*i, *j)));
+			}
 		}
 	}
-	return max_dist;
 }
 
 // Print this opbject on the given stream.
 void TemporalOrderings::print(ostream& os) const {
 	size_t n = distance.size();
-	for (size_t r = 0; r <= n; r++) {
+	for (size_t r = 0; r < n; r++) {
 		os << endl;
-		for (size_t c = 0; c <= n; c++) {
+		for (size_t c = 0; c < n; c++) {
 			os.width(7);
 			int d = get_distance(r, c);
 			if (d < INT_MAX) {
@@ -3,8 +3,12 @@
 #include "chain.h"
 #include "formulas.h"
 
+#include <atomic>
 #include <map>
 #include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 class Effect;
 class Step;
@@ -137,16 +141,24 @@ class Orderings :public RCObject {
 
 	friend ostream& operator<<(ostream& os, const Orderings& o);
 
+	// Serial number of the next ordering collection to be created.
+	static std::atomic<size_t> next_serial;
+
+	// Serial number of this ordering collection.
+	size_t serial;
+	// Whether this is a temporal ordering collection.
+	bool temporal;
+
 protected:
-	// Construct an empty ordering collection.
-	Orderings() {
+	// Construct an empty ordering collection, which is temporal or not.
+	explicit Orderings(bool temporal) : serial(next_serial++), temporal(temporal) {
 #ifdef DEBUG_MEMORY
 		++created_orderings;
 #endif
 	}
 
-	// Construct a copy of this ordering collection.
-	Orderings(const Orderings& o) {
+	// Construct a copy of this ordering collection; the copy gets a serial number of its own, since it is refined after being copied.
+	Orderings(const Orderings& o) : serial(next_serial++), temporal(o.temporal) {
 #ifdef DEBUG_MEMORY
 		++created_orderings;
 #endif
@@ -169,6 +181,12 @@ public:
 		destructive_deref(o);
 	}
 
+	// Return the serial number of this ordering collection; no other ordering collection has the same number.
+	size_t get_serial() const { return serial; }
+
+	// Check if this is a temporal ordering collection; checking this is much cheaper than a dynamic cast.
+	bool is_temporal() const { return temporal; }
+
 	// Deletes this ordering collection.
 	virtual ~Orderings() {
 #ifdef DEBUG_MEMORY
@@ -212,47 +230,87 @@ public:
 	// Return the makespan of this ordering collection.
 	virtual float makespan(const map<pair<size_t,
 		StepTime::StepPoint>, float>& min_times) const = 0;
-};
 
+	// Check if the makespan depends on the minimum times of steps passed to makespan.
+	virtual bool uses_min_times() const = 0;
 
+	// Append the constraints between the given steps, taken in the given order, to the given plan signature.
+	virtual void add_signature(vector<size_t>& sig,
+		const vector<size_t>& step_ids) const = 0;
+};
 
-// =================== BoolVector ====================
 
-// A collectible bool vector.
-class BoolVector :public vector<bool>, public RCObject {
-public:
-	// Register use of the given vector. diff
-	static void register_use(const BoolVector* v) {
-		ref(v);
-	}
 
-	// Unregister use of the given vector.
-	static void unregister_use(const BoolVector* v) {
-		destructive_deref(v);
-	}
+// =================== BitChunk ====================
 
-	// Construct a vector with n copies of b.
-	BoolVector(size_t n, bool b)
-		:vector<bool>(n, b) {
+// A fixed-size chunk of a row of a bit matrix, shared by copies of the matrix until it is written.
+class BitChunk :public RCObject {
+public:
+	// Number of 64-bit words in a chunk.
+	static const size_t WORDS = 4;
+	// Number of bits in a chunk.
+	static const size_t BITS = 64 * WORDS;
+
+	// The bits of this chunk.
+	unsigned long long words[WORDS];
+
+	// Construct a chunk with no bits set.
+	BitChunk() {
+		for (size_t i = 0; i < WORDS; i++) {
+			words[i] = 0;
+		}
 #ifdef DEBUG_MEMORY
-		++created_bool_vectors;
+		++created_bit_chunks;
 #endif //DEBUG_MEMORY
 	}
 
-	// Construct a copy of the given vector.
-	BoolVector(const BoolVector& v)
-		:vector<bool>(v) {
+	// Construct a copy of the given chunk.
+	BitChunk(const BitChunk& c) {
+		for (size_t i = 0; i < WORDS; i++) {
+			words[i] = c.words[i];
+		}
 #ifdef DEBUG_MEMORY
-		++created_bool_vectors;
+		++created_bit_chunks;
 #endif //DEBUG_MEMORY
 	}
 
 #ifdef DEBUG_MEMORY
-	// Destruct this vector. ???
-	~BoolVector() {
-		++deleted_bool_vectors;
+	// Destruct this chunk.
+	~BitChunk() {
+		++deleted_bit_chunks;
 	}
 #endif //DEBUG_MEMORY
+
+	// Check if the given bits include a bit that is not set in the given chunk, which may be null for a chunk with no bits set.
+	static bool adds_bits(const BitChunk* chunk, const unsigned long long* bits) {
+#ifdef __AVX2__
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bits));
+		if (chunk == 0) {
+			return !_mm256_testz_si256(b, b);
+		}
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk->words));
+		return !_mm256_testc_si256(c, b);
+#else
+		unsigned long long missing = 0;
+		for (size_t i = 0; i < WORDS; i++) {
+			missing |= bits[i] & ~((chunk != 0) ? chunk->words[i] : 0);
+		}
+		return missing != 0;
+#endif
+	}
+
+	// Set the given bits in this chunk.
+	void merge(const unsigned long long* bits) {
+#ifdef __AVX2__
+		__m256i* w = reinterpret_cast<__m256i*>(words);
+		_mm256_storeu_si256(w, _mm256_or_si256(_mm256_loadu_si256(w),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bits))));
+#else
+		for (size_t i = 0; i < WORDS; i++) {
+			words[i] |= bits[i];
+		}
+#endif
+	}
 };
 
 
@@ -260,14 +318,23 @@ public:
 
 // A collection of binary ordering constraints.
 class BinaryOrderings :public Orderings {
-	// Matrix representing the transitive closure of the ordering constraints.
-	vector<const BoolVector*> before;
-
-	// Construct a copy of this ordering collection.
-	BinaryOrderings(const BinaryOrderings& o) {
-		size_t n = before.size();
-		for (size_t i = 0; i < n; i++) {
-			BoolVector::register_use(before[i]);
+	// Matrix representing the transitive closure of the ordering constraints, stored row by row in chunks; the row of step i has bit j - 1 set if step i is ordered before step j, and a null chunk has no bits set.
+	vector<const BitChunk*> chunks;
+	// Number of steps (rows and columns) of the matrix.
+	size_t num_steps;
+	// Number of chunks in a row.
+	size_t row_chunks;
+	// Number of steps in the longest chain of ordered steps starting at each step.
+	vector<int> heights;
+	// Number of steps in the longest chain of ordered steps.
+	int max_height;
+
+	// Construct a copy of this ordering collection, sharing all chunks.
+	BinaryOrderings(const BinaryOrderings& o)
+		: Orderings(o), chunks(o.chunks), num_steps(o.num_steps),
+		row_chunks(o.row_chunks), heights(o.heights), max_height(o.max_height) {
+		for (size_t i = 0; i < chunks.size(); i++) {
+			ref(chunks[i]);
 		}
 	}
 
@@ -284,13 +351,18 @@ class BinaryOrderings :public Orderings {
 	// Return true if the first step is ordered before the second step.
 	bool is_before(size_t id1, size_t id2) const;
 
-	// Order the first step before the second step.
-	void set_before(map<size_t, BoolVector*>& own_data,
-		size_t id1, size_t id2);
+	// Extend the matrix to the given number of steps.
+	void add_steps(size_t n);
+
+	// Set the given bits in the row of the given step; own_chunks holds the chunks already copied for writing.
+	void merge_row(vector<BitChunk*>& own_chunks, size_t id,
+		const vector<unsigned long long>& bits);
+
+	// Recompute the heights of the given steps, which hold every step whose height may have changed.
+	void update_heights(vector<size_t>& ids);
 
 	// Update the transitive closure given a new ordering constraint.
-	void fill_transitive(map<size_t, BoolVector*>& own_data,
-		const Ordering& ordering);
+	void fill_transitive(const Ordering& ordering);
 
 protected:
 	// Print this object on the given stream.
@@ -298,13 +370,13 @@ protected:
 
 public:
 	// Construct an empty ordering collection.
-	BinaryOrderings() {}
+	BinaryOrderings()
+		: Orderings(false), num_steps(0), row_chunks(0), max_height(0) {}
 
 	// Destruct this ordering collection.
 	virtual ~BinaryOrderings() {
-		size_t n = before.size();
-		for (size_t i = 0; i < n; i++) {
-			BoolVector::unregister_use(before[i]);
+		for (size_t i = 0; i < chunks.size(); i++) {
+			destructive_deref(chunks[i]);
 		}
 	}
 
@@ -344,6 +416,13 @@ public:
 	// Return the makespan of this ordering collection.
 	virtual float makespan(const map<pair<size_t,
 		StepTime::StepPoint>, float>& min_times) const;
+
+	// Check if the makespan depends on the minimum times of steps passed to makespan.
+	virtual bool uses_min_times() const { return true; }
+
+	// Append the constraints between the given steps, taken in the given order, to the given plan signature.
+	virtual void add_signature(vector<size_t>& sig,
+		const vector<size_t>& step_ids) const;
 };
 
 
@@ -394,19 +473,36 @@ public:
 // A collection of temporal ordering constraints.
 class TemporalOrderings :public Orderings {
 
-	// Matrix representing the minimal network for the ordering constraints.
+	// Matrix representing the minimal network for the ordering constraints,
+	// with one row of maximum distances from each time node.  A row only
+	// holds columns up to the last time node it was widened to; distances
+	// to later time nodes are infinite.
 	vector<const IntVector*> distance;
-	// Steps that are linked to the goal.
-	const Chain<size_t>* goal_achievers;
+	// Steps that are linked to the goal, indexed by step id.
+	vector<bool> goal_achievers;
+	// Latest earliest end time of a step linked to the goal, in multiples of the threshold.
+	int goal_end;
 
 	// Construct a copy of this ordering collection.
 	TemporalOrderings(const TemporalOrderings& o)
-		:Orderings(o), distance(o.distance), goal_achievers(o.goal_achievers) {
+		:Orderings(o), distance(o.distance), goal_achievers(o.goal_achievers),
+		goal_end(o.goal_end) {
 		size_t n = distance.size();
 		for (size_t i = 0; i < n; i++) {
 			IntVector::register_use(distance[i]);
 		}
-		RCObject::ref(goal_achievers);
+	}
+
+	// Check if the given step is linked to the goal.
+	bool is_goal_achiever(size_t id) const {
+		return id < goal_achievers.size() && goal_achievers[id];
+	}
+
+	// Update the cached makespan given that the distance from the given time node to the time origin may have changed.
+	void update_goal_end(size_t t) {
+		if (t % 2 == 0 && is_goal_achiever(t / 2) && -get_distance(t, 0) > goal_end) {
+			goal_end = -get_distance(t, 0);
+		}
 	}
 
 	// Return the time node for the given step.
@@ -414,15 +510,26 @@ class TemporalOrderings :public Orderings {
 		return (t.point == StepTime::START) ? 2 * id - 1 : 2 * id;
 	}
 
+	// Return the number of steps with time nodes in this ordering collection.
+	size_t num_steps() const {
+		return (distance.size() - 1) / 2;
+	}
+
 	// Return the maximum distance from the first and the second time node.
 	int get_distance(size_t t1, size_t t2) const;
 
+	// Return the row of the given time node owned by this ordering collection, with at least the given number of columns.
+	IntVector& own_row(vector<IntVector*>& own_rows, size_t t, size_t width);
+
 	// Set the maximum distance from the first and the second time node.
-	void set_distance(map<size_t, IntVector*>& own_data,
+	void set_distance(vector<IntVector*>& own_rows,
 		size_t t1, size_t t2, int d);
 
-	// Update the transitive closure given a new ordering constraint.
-	bool fill_transitive(map<size_t, IntVector*>& own_data,
+	// Add unconstrained time nodes for the start and end of a new step.
+	void add_time_nodes(vector<IntVector*>& own_rows);
+
+	// Update the minimal network given a new ordering constraint.
+	bool fill_transitive(vector<IntVector*>& own_rows,
 		size_t i, size_t j, int dist);
 
 protected:
@@ -432,7 +539,9 @@ protected:
 public:
 	// Construct an empty ordering collection.
 	TemporalOrderings()
-		:goal_achievers(0) {}
+		:Orderings(true), distance(1, new IntVector(1, 0)), goal_end(0) {
+		IntVector::register_use(distance[0]);
+	}
 
 	// Destruct this ordering collection.
 	virtual ~TemporalOrderings() {
@@ -440,7 +549,6 @@ public:
 		for (size_t i = 0; i < n; i++) {
 			IntVector::unregister_use(distance[i]);
 		}
-		RCObject::destructive_deref(goal_achievers);
 	}
 
 	// Check if the first step could be ordered before the second step.
@@ -486,4 +594,11 @@ public:
 	// Return the makespan of this ordering collection.
 	virtual float makespan(const map<pair<size_t,
 		StepTime::StepPoint>, float>& min_times) const;
+
+	// Check if the makespan depends on the minimum times of steps passed to makespan.
+	virtual bool uses_min_times() const { return false; }
+
+	// Append the constraints between the given steps, taken in the given order, to the given plan signature.
+	virtual void add_signature(vector<size_t>& sig,
+		const vector<size_t>& step_ids) const;
 };
\ No newline at end of file
@@ -23,7 +23,10 @@ Parameters::Parameters()
 	: time_limit(UINT_MAX), search_algorithm(A_STAR),
 	heuristic("UCPOP"), action_cost(UNIT_COST), weight(1.0),
 	random_open_conditions(false), ground_actions(false),
-	domain_constraints(false), keep_static_preconditions(true) {
+	domain_constraints(false), keep_static_preconditions(true),
+	parallel_flaw_orders(false), search_threads(1),
+	duplicate_detection(false), memory_limit(100000),
+	lazy_evaluation(false) {
 	flaw_orders.push_back(FlawSelectionOrder("UCPOP")),
 		search_limits.push_back(UINT_MAX);
 }
@@ -47,6 +50,9 @@ void Parameters::set_search_algorithm(const string& name) {
 	else if (strcasecmp(n, "HC") == 0) {
 		search_algorithm = HILL_CLIMBING;
 	}
+	else if (strcasecmp(n, "SMA") == 0) {
+		search_algorithm = SMA_STAR;
+	}
 	else {
 		throw InvalidSearchAlgorithm(name);
 	}
@@ -34,7 +34,7 @@ public:
 class Parameters {
 public:
 	// Valid search algorithms.
-	typedef enum { A_STAR, IDA_STAR, HILL_CLIMBING } SearchAlgorithm;
+	typedef enum { A_STAR, IDA_STAR, HILL_CLIMBING, SMA_STAR } SearchAlgorithm;
 	// Valid action costs.
 	typedef enum { UNIT_COST, DURATION, RELATIVE } ActionCost;
 
@@ -60,6 +60,16 @@ public:
 	bool domain_constraints;
 	// Whether to keep static preconditions when using domain constraints.
 	bool keep_static_preconditions;
+	// Whether to run the flaw selection orders in parallel, with one search thread per order.
+	bool parallel_flaw_orders;
+	// Number of threads to use for A* search.
+	size_t search_threads;
+	// Whether to discard plans that duplicate a plan already queued or expanded.
+	bool duplicate_detection;
+	// Maximum number of plans to keep in memory with memory-bounded search.
+	size_t memory_limit;
+	// Whether to rank plans only when they are taken from the queue.
+	bool lazy_evaluation;
 
 	// Construct default planning parameters.
 	Parameters();
@@ -7,22 +7,346 @@
 #include "requirements.h"
 #include "parameters.h"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
 #include <limits>
+#include <mutex>
 #include <queue>
+#include <thread>
 #include <typeinfo>
+#include <unordered_set>
 
 extern int verbosity;
 
 //=================== PlanQueue ====================
 
-// A plan queue.
-class PlanQueue : public priority_queue<const Plan*> {
+// A plan queue.  Plans are kept in buckets by their primary rank rounded
+// down, with a binary heap of plans in each bucket.  The rank of a plan is
+// packed into its queue entry when the plan is pushed, so that plans in
+// the queue are compared without touching the plans themselves.
+class PlanQueue {
+	// Number of rank components packed into a queue entry.
+	static const size_t KEY_SIZE = 4;
+	// Number of buckets; plans with higher primary ranks share the last bucket.
+	static const size_t MAX_BUCKETS = 65536;
+
+	// A queue entry.
+	struct Entry {
+		// Packed rank of the plan.
+		float key[KEY_SIZE];
+		// Number of rank components of the plan.
+		size_t key_size;
+		// The plan.
+		const Plan* plan;
+	};
+
+	// Heap ordering of queue entries, with the best entry on top.
+	struct EntryLess {
+		bool operator()(const Entry& e1, const Entry& e2) const {
+			size_t n = min(e1.key_size, e2.key_size);
+			for (size_t i = 0; i < n && i < KEY_SIZE; i++) {
+				if (e1.key[i] != e2.key[i]) {
+					return e1.key[i] > e2.key[i];
+				}
+			}
+			// Compare the rest of the ranks through the plans.
+			return n > KEY_SIZE && *e1.plan < *e2.plan;
+		}
+	};
+
+	// Buckets of queue entries, indexed by rounded primary rank.
+	vector<vector<Entry> > buckets;
+	// Index of the first non-empty bucket, if the queue is not empty.
+	size_t first;
+	// Number of plans in the queue.
+	size_t count;
+
+public:
+	// Construct an empty plan queue.
+	PlanQueue() : first(0), count(0) {}
+
+	// Check if this queue is empty.
+	bool empty() const { return count == 0; }
+
+	// Return the number of plans in this queue.
+	size_t size() const { return count; }
+
+	// Return the best plan in this queue.
+	const Plan* top() const { return buckets[first].front().plan; }
+
+	// Add a plan to this queue.
+	void push(const Plan* plan) {
+		float r = plan->primary_rank();
+		Entry e;
+		e.key_size = plan->rank.size();
+		for (size_t i = 0; i < e.key_size && i < KEY_SIZE; i++) {
+			e.key[i] = plan->rank[i];
+		}
+		e.plan = plan;
+		size_t b = 0;
+		if (r >= MAX_BUCKETS - 1) {
+			b = MAX_BUCKETS - 1;
+		}
+		else if (r > 0.0f) {
+			b = size_t(r);
+		}
+		if (b >= buckets.size()) {
+			buckets.resize(b + 1);
+		}
+		buckets[b].push_back(e);
+		push_heap(buckets[b].begin(), buckets[b].end(), EntryLess());
+		if (count == 0 || b < first) {
+			first = b;
+		}
+		count++;
+	}
+
+	// Remove the best plan from this queue.
+	void pop() {
+		vector<Entry>& bucket = buckets[first];
+		pop_heap(bucket.begin(), bucket.end(), EntryLess());
+		bucket.pop_back();
+		count--;
+		while (count > 0 && buckets[first].empty()) {
+			first++;
+		}
+	}
+};
+
+//=================== TranspositionTable ====================
+
+// A table of the signatures of the plans that have been queued or expanded.
+class TranspositionTable :public unordered_set<PlanSignature, PlanSignatureHash> {
 };
 
 //=================== PredicateAchieverMap ====================
 
 // A mapping of predicate names to achievers.
 class PredicateAchieverMap :public map<Predicate, ActionEffectMap> {
+};
+
+//=================== PredicateIndex ====================
+
+// An effect of a plan step, as stored in a predicate index.
+struct StepEffect {
+	// The step.
+	const Step* step;
+	// The effect.
+	const Effect* effect;
+	// Position of the step in the chain of steps, counting from the oldest step.
+	size_t step_no;
+	// Position of the effect in the effects of the action of the step.
+	size_t effect_no;
+
+	// Construct an indexed step effect.
+	StepEffect(const Step& step, const Effect& effect, size_t step_no, size_t effect_no)
+		: step(&step), effect(&effect), step_no(step_no), effect_no(effect_no) {}
+};
+
+// A causal link, as stored in a predicate index.
+struct LinkCondition {
+	// The link.
+	const Link* link;
+	// Position of the link in the chain of links, counting from the oldest link.
+	size_t link_no;
+
+	// Construct an indexed causal link.
+	LinkCondition(const Link& link, size_t link_no)
+		: link(&link), link_no(link_no) {}
+};
+
+// Persistent index of the elements of a plan chain by predicate and
+// polarity.  The index of a child plan copies the table of its parent's
+// index, but shares the chains of indexed elements with it, so that only
+// the elements the child adds in front of its parent's chain are indexed.
+template<class T>
+class PredicateIndex :public RCObject {
+	// Chains of indexed elements, newest first, by predicate and polarity.
+	vector<const Chain<T>*> entries;
+	// The plan chain covered by this index.
+	const void* source;
+	// Number of elements of the plan chain covered by this index.
+	size_t num_elements;
+
+public:
+	// Construct an index of the given plan chain, initially holding the entries of the given index.
+	PredicateIndex(const PredicateIndex<T>* base, const void* source)
+		: source(source), num_elements(0) {
+		if (base != NULL) {
+			entries = base->entries;
+			num_elements = base->num_elements;
+			for (size_t i = 0; i < entries.size(); i++) {
+				ref(entries[i]);
+			}
+		}
+	}
+
+	// Destruct this index.
+	~PredicateIndex() {
+		for (size_t i = 0; i < entries.size(); i++) {
+			destructive_deref(entries[i]);
+		}
+	}
+
+	// Return the plan chain covered by this index.
+	const void* get_source() const { return source; }
+
+	// Return the number of elements of the plan chain covered by this index, and count one more.
+	size_t add_element() { return num_elements++; }
+
+	// Return the entries with the given predicate and polarity.
+	const Chain<T>* find(const Predicate& predicate, bool negated) const {
+		size_t key = 2 * predicate.get_index() + (negated ? 1 : 0);
+		return (key < entries.size()) ? entries[key] : NULL;
+	}
+
+	// Add an entry with the given predicate and polarity in front of the entries already in the index.
+	void add(const Predicate& predicate, bool negated, const T& entry) {
+		size_t key = 2 * predicate.get_index() + (negated ? 1 : 0);
+		if (key >= entries.size()) {
+			entries.resize(key + 1, NULL);
+		}
+		const Chain<T>* old_entries = entries[key];
+		entries[key] = new Chain<T>(entry, old_entries);
+		ref(entries[key]);
+		destructive_deref(old_entries);
+	}
+};
+
+//=================== InitEffectIndex ====================
+
+// Effects of the initial-state action with a single predicate, indexed by
+// the objects at each argument position, so that the effects that can
+// unify with a literal are found without visiting all initial conditions.
+class InitEffectIndex {
+	// Mapping of objects to positions of effects in this index.
+	class ObjectEffectsMap :public map<int, vector<size_t> > {
+	};
+
+	// Effects of this index, in the order they were added.
+	vector<const Effect*> effects;
+	// Positions of the effects with each object at each argument position, in order.
+	vector<ObjectEffectsMap> postings;
+	// Whether all effects of this index are ground, so that the postings cover them.
+	bool ground;
+
+public:
+	// Construct an empty index.
+	InitEffectIndex() : ground(true) {}
+
+	// Add the given effect to this index.
+	void add(const Effect& effect) {
+		const Literal& literal = effect.get_literal();
+		size_t pos = effects.size();
+		effects.push_back(&effect);
+		if (postings.size() < literal.get_arity()) {
+			postings.resize(literal.get_arity());
+		}
+		for (size_t i = 0; i < literal.get_arity(); i++) {
+			const Term& term = literal.get_term(i);
+			if (term.is_object()) {
+				postings[i][term.get_index()].push_back(pos);
+			}
+			else {
+				ground = false;
+			}
+		}
+	}
+
+	// Find the effects of this index that may unify with the given literal
+	// of the given step, and return false if there are none.  The
+	// candidates are set to the positions of the shortest list of effects
+	// sharing an object with the bound arguments of the literal, or to NULL
+	// if all effects are candidates.
+	bool find_candidates(const vector<size_t>*& candidates,
+		const Literal& literal, size_t step_id, const Bindings& bindings) const {
+		candidates = NULL;
+		if (!ground) {
+			return !effects.empty();
+		}
+		for (size_t i = 0; i < literal.get_arity(); i++) {
+			Term term = bindings.get_binding(literal.get_term(i), step_id);
+			if (term.is_object()) {
+				if (i >= postings.size()) {
+					return false;
+				}
+				ObjectEffectsMap::const_iterator oi = postings[i].find(term.get_index());
+				if (oi == postings[i].end()) {
+					return false;
+				}
+				if (candidates == NULL || (*oi).second.size() < candidates->size()) {
+					candidates = &(*oi).second;
+				}
+			}
+		}
+		return !effects.empty();
+	}
+
+	// Return the number of the given candidates.
+	size_t size(const vector<size_t>* candidates) const {
+		return (candidates != NULL) ? candidates->size() : effects.size();
+	}
+
+	// Return the effect of the given candidates at the given position.
+	const Effect& get_effect(const vector<size_t>* candidates, size_t k) const {
+		return *effects[(candidates != NULL) ? (*candidates)[k] : k];
+	}
+};
+
+//=================== TrialLinks ====================
+
+// A link to an open condition whose effect was found to unify with the
+// condition while counting the refinements of the open condition.
+struct TrialLink {
+	// The step the link would be from.
+	Step step;
+	// The effect the link would be from.
+	const Effect* effect;
+	// Most general unifier of the effect and the open condition.
+	BindingList mgu;
+
+	// Construct a trial link.
+	TrialLink(const Step& step, const Effect& effect, const BindingList& mgu)
+		: step(step), effect(&effect), mgu(mgu) {}
+};
+
+// All links to an open condition whose effects unify with the condition,
+// in the order the achievers are visited, found with the bindings and
+// orderings with the given serial numbers.
+struct TrialLinks {
+	// Serial number of the bindings the links were found with.
+	size_t bindings;
+	// Serial number of the orderings the links were found with, or zero if they do not depend on orderings.
+	size_t orderings;
+	// The links.
+	vector<TrialLink> links;
+};
+
+// A mapping of open condition ids to trial links.
+class TrialLinksMap :public map<size_t, TrialLinks> {
+};
+
+// The outcome of checking a threat while counting its refinements, found
+// with the bindings and orderings with the given serial numbers.
+struct ThreatTrial {
+	// Serial number of the bindings the threat was checked with.
+	size_t bindings;
+	// Serial number of the orderings the threat was checked with.
+	size_t orderings;
+	// Whether the threat is real.
+	bool real;
+	// Most general unifier of the threatening effect and the condition of the link.
+	BindingList unifier;
+	// Number of separations, promotions and demotions, or -1 if not counted.
+	int separable;
+	int promotable;
+	int demotable;
+};
+
+// A mapping of unsafe link ids to threat trials.
+class ThreatTrialsMap :public map<size_t, ThreatTrial> {
 };
 
 
@@ -37,25 +361,338 @@ static const PlanningGraph* planning_graph;
 //The goal action. 
 static Action* goal_action;
 //Maps predicates to actions. 
-static PredicateAchieverMap achieves_pred;
+static AchieverTable achieves_pred;
 //Maps negated predicates to actions. 
-static PredicateAchieverMap achieves_neg_pred;
-//Whether last flaw was a static predicate. 
-static bool static_pred_flaw;
+static AchieverTable achieves_neg_pred;
+//Initial-state achievers of each predicate, in the order of the achievers of the predicate (lifted actions only). 
+static vector<InitEffectIndex> init_achievers;
+//Initial conditions of each predicate, in the order of the effects of the initial-state action. 
+static vector<InitEffectIndex> init_conditions;
+//Whether last flaw was a static predicate (one flag per search thread). 
+static thread_local bool static_pred_flaw;
+//Links for new steps found while counting refinements during the last flaw selection (one table per search thread). 
+static thread_local TrialLinksMap new_step_trials;
+//Links from existing steps found while counting refinements during the last flaw selection (one table per search thread). 
+static thread_local TrialLinksMap reuse_step_trials;
+//Threats checked while counting refinements during the last flaw selection (one table per search thread). 
+static thread_local ThreatTrialsMap threat_trials;
+//Set when the threads of a parallel flaw order portfolio should stop searching. 
+static atomic<bool> portfolio_done;
+//Flaw selection order that first found a complete plan in a parallel portfolio, or -1. 
+static atomic<int> portfolio_winner;
+//First exception thrown by a thread of a parallel portfolio. 
+static exception_ptr portfolio_error;
+//Lock for the first exception thrown by a thread of a parallel portfolio. 
+static mutex portfolio_lock;
+//Maximum number of plans generated by hill climbing while escaping a plateau. 
+static const size_t HILL_CLIMBING_LOOKAHEAD = 10000;
+
+
+//=================== SearchStatistics ====================
+
+// Statistics of a search with a single flaw selection order.
+struct SearchStatistics {
+	// Number of generated plans.
+	size_t num_generated_plans;
+	// Number of visited plans.
+	size_t num_visited_plans;
+	// Number of static preconditions encountered.
+	size_t num_static;
+	// Number of dead ends encountered.
+	size_t num_dead_ends;
+	// Number of duplicate plans discarded.
+	size_t num_duplicates;
+
+	// Construct empty search statistics.
+	SearchStatistics()
+		: num_generated_plans(0), num_visited_plans(0),
+		num_static(0), num_dead_ends(0), num_duplicates(0) {}
+};
+
+
+//=================== PlanMailbox ====================
+
+// A lock-free mailbox through which search threads pass plans to the thread that owns them.
+class PlanMailbox {
+	// A posted plan.
+	struct Message {
+		// The plan.
+		const Plan* plan;
+		// The previously posted message.
+		Message* next;
+	};
+
+	// The most recently posted message.
+	atomic<Message*> messages;
+
+public:
+	// Construct an empty mailbox.
+	PlanMailbox() : messages(NULL) {}
+
+	// Post a plan to this mailbox.
+	void post(const Plan* plan) {
+		Message* m = new Message();
+		m->plan = plan;
+		m->next = messages.load();
+		while (!messages.compare_exchange_weak(m->next, m)) {
+		}
+	}
+
+	// Check if no plan has been posted to this mailbox since it was last emptied.
+	bool empty() const {
+		return messages.load() == NULL;
+	}
+
+	// Move all posted plans to the given list, and return the number of plans moved.
+	size_t collect(vector<const Plan*>& plans) {
+		size_t n = 0;
+		Message* m = messages.exchange(NULL);
+		while (m != NULL) {
+			plans.push_back(m->plan);
+			Message* next = m->next;
+			delete m;
+			m = next;
+			n++;
+		}
+		return n;
+	}
+};
+
+
+//=================== DistributedSearch ====================
+
+// Shared state of a hash-distributed parallel A* search.  Every plan is
+// owned by the thread selected by a hash of its structure, and only the
+// owner queues and expands it.
+struct DistributedSearch {
+	// Number of search threads.
+	size_t num_threads;
+	// Maximum number of plans to generate.
+	size_t search_limit;
+	// Mailboxes of the search threads.
+	vector<PlanMailbox> mailboxes;
+	// Primary rank of the best plan held by each search thread.
+	vector<atomic<float> > best_ranks;
+	// Statistics of each search thread.
+	vector<SearchStatistics> stats;
+	// Number of plans generated by all threads; may overshoot the search limit by the number of threads.
+	atomic<size_t> num_generated_plans;
+	// Id of the next plan to be generated.
+	atomic<size_t> next_plan_id;
+	// Number of plans sent between threads.
+	atomic<size_t> num_sent;
+	// Number of plans received from other threads.
+	atomic<size_t> num_received;
+	// Best complete plan found so far.
+	const Plan* incumbent;
+	// Primary rank of the best complete plan found so far.
+	atomic<float> incumbent_rank;
+	// Plan that was being expanded when the search limit was reached.
+	const Plan* limit_plan;
+	// Lock for the incumbent, the limit plan, and the error.
+	mutex lock;
+	// Set when the search threads should stop.
+	atomic<bool> done;
+	// First exception thrown by a search thread.
+	exception_ptr error;
+	// Number of search threads waiting for plans.
+	atomic<size_t> num_idle;
+	// Lock for waiting for plans.
+	mutex idle_lock;
+	// Notified when plans are sent to a waiting thread or the search stops.
+	condition_variable idle;
+
+	// Construct the shared state of a search with the given number of threads.
+	DistributedSearch(size_t num_threads, size_t search_limit)
+		: num_threads(num_threads), search_limit(search_limit), mailboxes(num_threads),
+		best_ranks(num_threads), stats(num_threads), num_generated_plans(0),
+		next_plan_id(1), num_sent(0), num_received(0), incumbent(NULL),
+		incumbent_rank(numeric_limits<float>::infinity()), limit_plan(NULL),
+		done(false), num_idle(0) {
+		for (size_t i = 0; i < num_threads; i++) {
+			best_ranks[i] = numeric_limits<float>::infinity();
+		}
+	}
+
+	// Check if no thread holds or is about to receive a plan ranked better
+	// than the incumbent, in which case the incumbent is the best plan (or
+	// there is no plan), provided no plan is ranked below its parent.  That
+	// does not hold for every heuristic (ADD and ADDR, for instance), so the
+	// incumbent is then only the best plan the search could rank below the
+	// plans left unexpanded.  A thread expanding a plan keeps publishing the rank
+	// of that plan until all its children have been queued or sent, and
+	// plans received are published before they are counted, so reading the
+	// received count before the ranks and the sent count after them is safe.
+	bool exhausted() const {
+		size_t received = num_received;
+		float bound = incumbent_rank;
+		for (size_t i = 0; i < num_threads; i++) {
+			if (best_ranks[i] < bound) {
+				return false;
+			}
+		}
+		return received == num_sent;
+	}
+
+	// Send the given plan to the given thread, waking the thread if it waits for plans.
+	void send(size_t owner, const Plan* plan) {
+		num_sent++;
+		mailboxes[owner].post(plan);
+		// A thread counts itself idle before it checks its mailbox, so
+		// either it finds the plan or it is notified.
+		if (num_idle > 0) {
+			lock_guard<mutex> lock(idle_lock);
+			idle.notify_all();
+		}
+	}
+
+	// Stop the search threads.
+	void stop() {
+		lock_guard<mutex> lock(idle_lock);
+		done = true;
+		idle.notify_all();
+	}
+
+	// Wait until plans are sent to the given thread or the search stops.
+	void wait_for_plans(size_t thread_id) {
+		num_idle++;
+		{
+			unique_lock<mutex> lock(idle_lock);
+			while (!done && mailboxes[thread_id].empty()) {
+				idle.wait(lock);
+			}
+		}
+		num_idle--;
+	}
+};
+
+
+//=================== SmaNode ====================
+
+// A node in the search tree of a simplified memory-bounded A* search.
+struct SmaNode {
+	// Plan of this node.
+	const Plan* plan;
+	// Parent of this node, or NULL for the root.
+	SmaNode* parent;
+	// Depth of this node in the search tree.
+	size_t depth;
+	// Backed-up f-value of this node.
+	float f;
+	// Children of this node that are kept in memory.
+	vector<SmaNode*> children;
+	// Lowest f-value of the children of this node that have been pruned.
+	float forgotten_f;
+
+	// Construct a search tree node.
+	SmaNode(const Plan* plan, SmaNode* parent, float f)
+		: plan(plan), parent(parent),
+		depth((parent != NULL) ? parent->depth + 1 : 0), f(f),
+		forgotten_f(numeric_limits<float>::infinity()) {}
+};
+
+// Ordering of search tree leaves from the best (lowest f-value, deepest) to the worst.
+struct SmaNodeLess {
+	bool operator()(const SmaNode* n1, const SmaNode* n2) const {
+		if (n1->f != n2->f) {
+			return n1->f < n2->f;
+		}
+		else if (n1->depth != n2->depth) {
+			return n1->depth > n2->depth;
+		}
+		else {
+			return n1->plan->get_serial_no() < n2->plan->get_serial_no();
+		}
+	}
+};
+
+// Leaves of the search tree of a simplified memory-bounded A* search.
+class SmaLeaves :public set<SmaNode*, SmaNodeLess> {
+};
 
 
 //=================== Plan ====================
 
-// Less-than specialization for plan pointers.
-namespace std {
-	template<>
-	struct less<const Plan*>
-		: public binary_function<const Plan*, const Plan*, bool> {
-		// Comparison function operator.
-		bool operator()(const Plan* p1, const Plan* p2) const {
-			return *p1 < *p2;
-		}
-	};
+// Remove and return the best plan in the given queue, or NULL if the queue
+// is empty.  A plan with a provisional rank is ranked for real first, and
+// put back if another plan is now better; dead ends are deleted.
+static const Plan* pop_plan(PlanQueue& plans) {
+	while (!plans.empty()) {
+		const Plan* plan = plans.top();
+		plans.pop();
+		if (plan->update_rank()) {
+			if (plan->primary_rank() == numeric_limits<float>::infinity()) {
+				delete plan;
+				continue;
+			}
+			else if (!plans.empty() && *plan < *plans.top()) {
+				plans.push(plan);
+				continue;
+			}
+		}
+		return plan;
+	}
+	return NULL;
+}
+
+// Check if the given literal is negated.
+static bool is_negated(const Literal& literal) {
+	return literal.get_kind() == NEGATION_F;
+}
+
+// Return an index of the effects of the given steps, which extends the
+// given index if it covers a tail of the chain of steps.
+static const PredicateIndex<StepEffect>* index_effects(const Chain<Step>* steps,
+	const PredicateIndex<StepEffect>* base) {
+	vector<const Step*> new_steps;
+	const Chain<Step>* sc = steps;
+	for (; sc != NULL && (base == NULL || sc != base->get_source()); sc = sc->tail) {
+		new_steps.push_back(&sc->head);
+	}
+	if (base != NULL && sc != base->get_source()) {
+		base = NULL;
+	}
+	else if (base != NULL && new_steps.empty()) {
+		return base;
+	}
+	PredicateIndex<StepEffect>* index = new PredicateIndex<StepEffect>(base, steps);
+	// Index the oldest steps and the last effects first, so that they end up last.
+	for (size_t i = new_steps.size(); i > 0; i--) {
+		const Step& s = *new_steps[i - 1];
+		size_t step_no = index->add_element();
+		const EffectList& effects = s.get_action().get_effects();
+		for (size_t j = effects.size(); j > 0; j--) {
+			const Effect& e = *effects[j - 1];
+			index->add(e.get_literal().get_predicate(), is_negated(e.get_literal()),
+				StepEffect(s, e, step_no, j - 1));
+		}
+	}
+	return index;
+}
+
+// Return an index of the conditions of the given links, which extends the
+// given index if it covers a tail of the chain of links.
+static const PredicateIndex<LinkCondition>* index_links(const Chain<Link>* links,
+	const PredicateIndex<LinkCondition>* base) {
+	vector<const Link*> new_links;
+	const Chain<Link>* lc = links;
+	for (; lc != NULL && (base == NULL || lc != base->get_source()); lc = lc->tail) {
+		new_links.push_back(&lc->head);
+	}
+	if (base != NULL && lc != base->get_source()) {
+		base = NULL;
+	}
+	else if (base != NULL && new_links.empty()) {
+		return base;
+	}
+	PredicateIndex<LinkCondition>* index = new PredicateIndex<LinkCondition>(base, links);
+	// Index the oldest links first, so that they end up last.
+	for (size_t i = new_links.size(); i > 0; i--) {
+		const Link& l = *new_links[i - 1];
+		index->add(l.get_condition().get_predicate(), is_negated(l.get_condition()),
+			LinkCondition(l, index->add_element()));
+	}
+	return index;
 }
 
 // Id of goal step.
@@ -65,17 +702,22 @@ const size_t Plan::GOAL_ID = numeric_limits<size_t>::max();
 Plan::Plan(const Chain<Step>* steps, size_t num_steps,
 	const Chain<Link>* links, size_t num_links,
 	const Orderings& orderings, const Bindings& bindings,
-	const Chain<Unsafe>* unsafes, size_t num_unsafes,
-	const Chain<OpenCondition>* open_conds, size_t num_open_conds,
-	const Chain<MutexThreat>* mutex_threats, const Plan* parent)
+	const FlawSet<Unsafe>* unsafes, size_t num_unsafes,
+	const FlawSet<OpenCondition>* open_conds, size_t num_open_conds,
+	const FlawSet<MutexThreat>* mutex_threats, const Plan* parent)
 	:steps(steps), num_steps(num_steps),
 	links(links), num_links(num_links),
 	orderings(&orderings), bindings(&bindings),
 	unsafes(unsafes), num_unsafes(num_unsafes),
 	open_conds(open_conds), num_open_conds(num_open_conds),
-	mutex_threats(mutex_threats) {
+	mutex_threats(mutex_threats),
+	step_effects(index_effects(steps, (parent != NULL) ? parent->step_effects : NULL)),
+	link_conditions(index_links(links, (parent != NULL) ? parent->link_conditions : NULL)),
+	provisional_rank(false) {
 	RCObject::ref(steps);
 	RCObject::ref(links);
+	RCObject::ref(step_effects);
+	RCObject::ref(link_conditions);
 	Orderings::register_use(&orderings);
 	Bindings::register_use(&bindings);
 	RCObject::ref(unsafes);
@@ -90,7 +732,7 @@ Plan::Plan(const Chain<Step>* steps, size_t num_steps,
 }
 
 // Adds goal to chain of open conditions, and returns true if and only if the goal is consistent.
-static bool add_goal(const Chain<OpenCondition>*& open_conds,
+static bool add_goal(const FlawSet<OpenCondition>*& open_conds,
 	size_t& num_open_conds, BindingList& new_bindings,
 	const Formula& goal, size_t step_id,
 	bool test_only = false) {
@@ -104,283 +746,418 @@ static bool add_goal(const Chain<OpenCondition>*& open_conds,
 	while (!goals.empty()) {
 		const Formula* goal = goals.back();
 		goals.pop_back();
-		const Literal* l;
-		FormulaTime when;
-		const TimedLiteral* tl = dynamic_cast<const TimedLiteral*>(goal);
-		if (tl != NULL) {
-			l = &tl->get_literal();
-			when = tl->get_when();
-		}
-		else {
-			l = dynamic_cast<const Literal*>(goal);
-			when = AT_START_F;
-		}
-		if (l != NULL) {
+		switch (goal->get_kind()) {
+		case ATOM_F:
+		case NEGATION_F:
+		case TIMED_LITERAL_F:
+		{
+			const Literal* l;
+			FormulaTime when;
+			if (goal->get_kind() == TIMED_LITERAL_F) {
+				const TimedLiteral* tl = static_cast<const TimedLiteral*>(goal);
+				l = &tl->get_literal();
+				when = tl->get_when();
+			}
+			else {
+				l = static_cast<const Literal*>(goal);
+				when = AT_START_F;
+			}
 			if (!test_only
 				&& !(params->strip_static_preconditions()
 					&& PredicateTable::is_static(l->get_predicate()))) {
 				open_conds =
-					new Chain<OpenCondition>(OpenCondition(step_id, *l, when),
-						open_conds);
+					FlawSet<OpenCondition>::add(open_conds, OpenCondition(step_id, *l, when));
 			}
 			num_open_conds++;
 		}
-		else {
-			const Conjunction* conj = dynamic_cast<const Conjunction*>(goal);
-			if (conj != NULL) {
-				const FormulaList& gs = conj->get_conjuncts();
-				for (FormulaList::const_iterator fi = gs.begin();
-					fi != gs.end(); fi++) {
-					if (params->random_open_conditions) {
-						size_t pos = size_t((goals.size() + 1.0)*rand() / (RAND_MAX + 1.0));
-						if (pos == goals.size()) {
-							goals.push_back(*fi);
-						}
-						else {
-							const Formula* tmp = goals[pos];
-							goals[pos] = *fi;
-							goals.push_back(tmp);
-						}
+		break;
+		case CONJUNCTION_F:
+		{
+			const FormulaList& gs = static_cast<const Conjunction*>(goal)->get_conjuncts();
+			for (FormulaList::const_iterator fi = gs.begin();
+				fi != gs.end(); fi++) {
+				if (params->random_open_conditions) {
+					size_t pos = size_t((goals.size() + 1.0)*rand() / (RAND_MAX + 1.0));
+					if (pos == goals.size()) {
+						goals.push_back(*fi);
 					}
 					else {
-						goals.push_back(*fi);
+						const Formula* tmp = goals[pos];
+						goals[pos] = *fi;
+						goals.push_back(tmp);
 					}
 				}
+				else {
+					goals.push_back(*fi);
+				}
+			}
+		}
+		break;
+		case DISJUNCTION_F:
+			if (!test_only) {
+				open_conds = FlawSet<OpenCondition>::add(open_conds,
+					OpenCondition(step_id, *static_cast<const Disjunction*>(goal)));
+			}
+			num_open_conds++;
+			break;
+		case EQUALITY_F:
+		case INEQUALITY_F:
+		{
+			const BindingLiteral* bl = static_cast<const BindingLiteral*>(goal);
+			bool is_eq = (goal->get_kind() == EQUALITY_F);
+			new_bindings.push_back(Binding(bl->get_variable(),
+				bl->step_id1(step_id),
+				bl->get_term(),
+				bl->step_id2(step_id), is_eq));
+#ifdef BRANCH_ON_INEQUALITY //???
+			const Inequality* neq = is_eq ? NULL : static_cast<const Inequality*>(bl);
+			if (params->domain_constraints
+				&& neq != NULL && bl->get_term().is_variable()) {
+				// Both terms are variables, so handle specially.
+				if (!test_only) {
+					open_conds =
+						FlawSet<OpenCondition>::add(open_conds, OpenCondition(step_id, *neq));
+				}
+				num_open_conds++;
+				new_bindings.pop_back();
+			}
+#endif
+		}
+		break;
+		case EXISTS_F:
+		{
+			const Formula* body = &static_cast<const Exists*>(goal)->get_body();
+			if (params->random_open_conditions) {
+				size_t pos =
+					size_t((goals.size() + 1.0)*rand() / (RAND_MAX + 1.0));
+				if (pos == goals.size()) {
+					goals.push_back(body);
+				}
+				else {
+					const Formula* tmp = goals[pos];
+					goals[pos] = body;
+					goals.push_back(tmp);
+				}
 			}
 			else {
-				const Disjunction* disj = dynamic_cast<const Disjunction*>(goal);
-				if (disj != NULL) {
-					if (!test_only) {
-						open_conds =
-							new Chain<OpenCondition>(OpenCondition(step_id, *disj),
-								open_conds);
-					}
-					num_open_conds++;
+				goals.push_back(body);
+			}
+		}
+		break;
+		case FORALL_F:
+		{
+			const Formula& g = static_cast<const Forall*>(goal)->get_universal_base(
+				SubstitutionMap(), *problem);
+			if (params->random_open_conditions) {
+				size_t pos =
+					size_t((goals.size() + 1.0)*rand() / (RAND_MAX + 1.0));
+				if (pos == goals.size()) {
+					goals.push_back(&g);
 				}
 				else {
-					const BindingLiteral* bl = dynamic_cast<const BindingLiteral*>(goal);
-					if (bl != NULL) {
-						bool is_eq = (typeid(*bl) == typeid(Equality));
-						new_bindings.push_back(Binding(bl->get_variable(),
-							bl->step_id1(step_id),
-							bl->get_term(),
-							bl->step_id2(step_id), is_eq));
-#ifdef BRANCH_ON_INEQUALITY //???
-						const Inequality* neq = dynamic_cast<const Inequality*>(bl);
-						if (params->domain_constraints
-							&& neq != NULL && bl->get_term().is_variable()) {
-							// Both terms are variables, so handle specially.
-							if (!test_only) {
-								open_conds =
-									new Chain<OpenCondition>(OpenCondition(step_id, *neq),
-										open_conds);
-							}
-							num_open_conds++;
-							new_bindings.pop_back();
-						}
-#endif
-					}
-					else {
-						const Exists* exists = dynamic_cast<const Exists*>(goal);
-						if (exists != NULL) {
-							if (params->random_open_conditions) {
-								size_t pos =
-									size_t((goals.size() + 1.0)*rand() / (RAND_MAX + 1.0));
-								if (pos == goals.size()) {
-									goals.push_back(&exists->get_body());
-								}
-								else {
-									const Formula* tmp = goals[pos];
-									goals[pos] = &exists->get_body();
-									goals.push_back(tmp);
-								}
-							}
-							else {
-								goals.push_back(&exists->get_body());
-							}
-						}
-						else {
-							const Forall* forall = dynamic_cast<const Forall*>(goal);
-							if (forall != NULL) {
-								const Formula& g = forall->get_universal_base(SubstitutionMap(),
-									*problem);
-								if (params->random_open_conditions) {
-									size_t pos =
-										size_t((goals.size() + 1.0)*rand() / (RAND_MAX + 1.0));
-									if (pos == goals.size()) {
-										goals.push_back(&g);
-									}
-									else {
-										const Formula* tmp = goals[pos];
-										goals[pos] = &g;
-										goals.push_back(tmp);
-									}
-								}
-								else {
-									goals.push_back(&g);
-								}
-							}
-							else {
-								throw logic_error("unknown kind of goal");
-							}
-						}
-					}
+					const Formula* tmp = goals[pos];
+					goals[pos] = &g;
+					goals.push_back(tmp);
 				}
 			}
+			else {
+				goals.push_back(&g);
+			}
+		}
+		break;
+		default:
+			throw logic_error("unknown kind of goal");
 		}
 	}
 	return true;
 }
 
-// Return a set of achievers for the given literal.
-static const ActionEffectMap* literal_achievers(const Literal& literal) {
+// Return the achievers for the given literal.
+static AchieverRange literal_achievers(const Literal& literal) {
 	if (params->ground_actions) {
 		return planning_graph->literal_achievers(literal);
 	}
-	else if (typeid(literal) == typeid(Atom)) {
-		PredicateAchieverMap::const_iterator pai =
-			achieves_pred.find(literal.get_predicate());
-		return (pai != achieves_pred.end()) ? &(*pai).second : NULL;
+	else if (literal.get_kind() == ATOM_F) {
+		return achieves_pred.find(literal.get_predicate().get_index());
 	}
 	else {
-		PredicateAchieverMap::const_iterator pai =
-			achieves_neg_pred.find(literal.get_predicate());
-		return (pai != achieves_neg_pred.end()) ? &(*pai).second : NULL;
+		return achieves_neg_pred.find(literal.get_predicate().get_index());
 	}
+}
+
+// Add the given effect to the index for its predicate in the given table.
+static void index_init_effect(vector<InitEffectIndex>& indexes,
+	const Effect& effect) {
+	size_t p = effect.get_literal().get_predicate().get_index();
+	if (p >= indexes.size()) {
+		indexes.resize(p + 1);
+	}
+	indexes[p].add(effect);
+}
+
+// Return the index for the predicate of the given literal in the given table, or NULL if there is none.
+static const InitEffectIndex* find_init_index(
+	const vector<InitEffectIndex>& indexes, const Literal& literal) {
+	size_t p = literal.get_predicate().get_index();
+	return (p < indexes.size()) ? &indexes[p] : NULL;
+}
+
+// Find the effects of the given step among the given achievers of the
+// given literal open condition, and return their number.  For the
+// initial-state step of a plan with lifted actions, only the initial
+// conditions with the objects the condition is bound to are returned, from
+// the given index; otherwise the effects are the achievers starting at the
+// given iterator, and the index is set to NULL.
+static size_t step_achievers(const InitEffectIndex*& init,
+	const vector<size_t>*& candidates, AchieverRange::const_iterator& ai,
+	const Step& step, const Literal& literal, const OpenCondition& open_cond,
+	const Bindings& bindings, const AchieverRange& achievers) {
+	init = ((step.get_id() == 0 && !params->ground_actions
+		&& literal.get_kind() == ATOM_F)
+		? find_init_index(init_achievers, literal) : NULL);
+	if (init != NULL) {
+		return (init->find_candidates(candidates, literal, open_cond.get_step_id(),
+			bindings) ? init->size(candidates) : 0);
+	}
+	pair<AchieverRange::const_iterator, AchieverRange::const_iterator> b =
+		achievers.equal_range(&step.get_action());
+	ai = b.first;
+	return b.second - b.first;
+}
+
+// Cache the given refinement count with a flaw, unless counting draws random numbers and must be repeated to keep searches reproducible.
+static void cache_count(const RefinementCount& rc, int count,
+	size_t bindings, size_t orderings) {
+	if (!params->random_open_conditions) {
+		rc.set(count, bindings, orderings);
+	}
+}
+
+// Record the given links found for the given open condition while counting its refinements.
+static void record_trials(TrialLinksMap& trials, const OpenCondition& open_cond,
+	vector<TrialLink>& links, size_t bindings, size_t orderings) {
+	TrialLinks& t = trials[open_cond.get_id()];
+	t.bindings = bindings;
+	t.orderings = orderings;
+	t.links.swap(links);
+}
+
+// Return the links recorded for the given open condition with the given bindings and orderings, or NULL if there are none.
+static const TrialLinks* find_trials(const TrialLinksMap& trials,
+	const OpenCondition& open_cond, size_t bindings, size_t orderings) {
+	TrialLinksMap::const_iterator ti = trials.find(open_cond.get_id());
+	if (ti != trials.end() && (*ti).second.bindings == bindings
+		&& (*ti).second.orderings == orderings) {
+		return &(*ti).second;
+	}
+	return NULL;
+}
+
+// Check the given threat with the given bindings and orderings, recording
+// it if it has not been checked with them yet, and return its trial.
+static ThreatTrial& check_threat(const Unsafe& unsafe, const Orderings& orderings,
+	const Bindings& bindings) {
+	ThreatTrialsMap::iterator ti = threat_trials.find(unsafe.get_id());
+	if (ti != threat_trials.end() && (*ti).second.bindings == bindings.get_serial()
+		&& (*ti).second.orderings == orderings.get_serial()) {
+		return (*ti).second;
+	}
+	ThreatTrial& t = threat_trials[unsafe.get_id()];
+	t.bindings = bindings.get_serial();
+	t.orderings = orderings.get_serial();
+	t.unifier = BindingList();
+	t.separable = t.promotable = t.demotable = -1;
+	const Link& link = unsafe.get_link();
+	StepTime lt1 = link.get_effect_time();
+	StepTime lt2 = end_time(link.get_condition_time());
+	StepTime et = end_time(unsafe.get_effect());
+	t.real = (orderings.possibly_not_after(link.get_from_id(), lt1,
+		unsafe.get_step_id(), et)
+		&& orderings.possibly_not_before(link.get_to_id(), lt2,
+			unsafe.get_step_id(), et)
+		&& bindings.affects(t.unifier, unsafe.get_effect().get_literal(),
+			unsafe.get_step_id(),
+			link.get_condition(), link.get_to_id()));
+	return t;
 }
 
-// Find threats to the given link.
-static void link_threats(const Chain<Unsafe>*& unsafes, size_t& num_unsafes,
-	const Link& link, const Chain<Step>* steps,
+// Add a threat to the given link if the given effect of the given step threatens it.
+static void link_threat(const FlawSet<Unsafe>*& unsafes, size_t& num_unsafes,
+	const Link& link, const Step& s, const Effect& e,
 	const Orderings& orderings,
 	const Bindings& bindings) {
+	if (!domain->requirements.durative_actions
+		&& e.get_link_condition().is_contradiction()) {
+		return;
+	}
 	StepTime lt1 = link.get_effect_time();
 	StepTime lt2 = end_time(link.get_condition_time());
-	for (const Chain<Step>* sc = steps; sc != NULL; sc = sc->tail) {
-		const Step& s = sc->head;
-		if (orderings.possibly_not_after(link.get_from_id(), lt1,
-			s.get_id(), StepTime::AT_END)
-			&& orderings.possibly_not_before(link.get_to_id(), lt2,
-				s.get_id(), StepTime::AT_START)) {
-			const EffectList& effects = s.get_action().get_effects();
-			for (EffectList::const_iterator ei = effects.begin();
-				ei != effects.end(); ei++) {
-				const Effect& e = **ei;
-				if (!domain->requirements.durative_actions
-					&& e.get_link_condition().is_contradiction()) {
-					continue;
-				}
-				StepTime et = end_time(e);
-				if (!(s.get_id() == link.get_to_id() && et >= lt2)
-					&& orderings.possibly_not_after(link.get_from_id(), lt1, s.get_id(), et)
-					&& orderings.possibly_not_before(link.get_to_id(), lt2, s.get_id(), et)) {
-					if (typeid(link.get_condition()) == typeid(Negation)
-						|| !(link.get_from_id() == s.get_id() && lt1 == et)) {
-						if (bindings.affects(e.get_literal(), s.get_id(),
-							link.get_condition(), link.get_to_id())) {
-							unsafes = new Chain<Unsafe>(Unsafe(link, s.get_id(), e), unsafes);
-							num_unsafes++;
-						}
-					}
+	if (orderings.possibly_not_after(link.get_from_id(), lt1,
+		s.get_id(), StepTime::AT_END)
+		&& orderings.possibly_not_before(link.get_to_id(), lt2,
+			s.get_id(), StepTime::AT_START)) {
+		StepTime et = end_time(e);
+		if (!(s.get_id() == link.get_to_id() && et >= lt2)
+			&& orderings.possibly_not_after(link.get_from_id(), lt1, s.get_id(), et)
+			&& orderings.possibly_not_before(link.get_to_id(), lt2, s.get_id(), et)) {
+			if (is_negated(link.get_condition())
+				|| !(link.get_from_id() == s.get_id() && lt1 == et)) {
+				if (bindings.affects(e.get_literal(), s.get_id(),
+					link.get_condition(), link.get_to_id())) {
+					unsafes = FlawSet<Unsafe>::add(unsafes, Unsafe(link, s.get_id(), e));
+					num_unsafes++;
 				}
 			}
 		}
 	}
 }
 
-// Find the threatened links by the given step. * /
-static void step_threats(const Chain<Unsafe>*& unsafes, size_t& num_unsafes,
-	const Step& step, const Chain<Link>* links,
+// Find threats to the given link.  The given index covers a tail of the
+// given chain of steps, and only effects with the predicate of the link
+// condition and the opposite polarity are looked up in it.
+static void link_threats(const FlawSet<Unsafe>*& unsafes, size_t& num_unsafes,
+	const Link& link, const Chain<Step>* steps,
+	const PredicateIndex<StepEffect>& step_effects,
 	const Orderings& orderings,
 	const Bindings& bindings) {
-	const EffectList& effects = step.get_action().get_effects();
-	for (const Chain<Link>* lc = links; lc != NULL; lc = lc->tail) {
-		const Link& l = lc->head;
-		StepTime lt1 = l.get_effect_time();
-		StepTime lt2 = end_time(l.get_condition_time());
-		if (orderings.possibly_not_after(l.get_from_id(), lt1,
-			step.get_id(), StepTime::AT_END)
-			&& orderings.possibly_not_before(l.get_to_id(), lt2,
-				step.get_id(), StepTime::AT_START)) {
-			for (EffectList::const_iterator ei = effects.begin();
-				ei != effects.end(); ei++) {
-				const Effect& e = **ei;
-				if (!domain->requirements.durative_actions
-					&& e.get_link_condition().is_contradiction()) {
-					continue;
-				}
-				StepTime et = end_time(e);
-				if (!(step.get_id() == l.get_to_id() && et >= lt2)
-					&& orderings.possibly_not_after(l.get_from_id(), lt1, step.get_id(), et)
-					&& orderings.possibly_not_before(l.get_to_id(), lt2, step.get_id(), et)) {
-					if (typeid(l.get_condition()) == typeid(Negation)
-						|| !(l.get_from_id() == step.get_id() && lt1 == et)) {
-						if (bindings.affects(e.get_literal(), step.get_id(),
-							l.get_condition(), l.get_to_id())) {
-							unsafes = new Chain<Unsafe>(Unsafe(l, step.get_id(), e), unsafes);
-							num_unsafes++;
-						}
-					}
-				}
-			}
+	const Chain<Step>* sc = steps;
+	for (; sc != NULL && sc != step_effects.get_source(); sc = sc->tail) {
+		const Step& s = sc->head;
+		const EffectList& effects = s.get_action().get_effects();
+		for (EffectList::const_iterator ei = effects.begin();
+			ei != effects.end(); ei++) {
+			link_threat(unsafes, num_unsafes, link, s, **ei, orderings, bindings);
+		}
+	}
+	if (sc != NULL) {
+		const Literal& condition = link.get_condition();
+		for (const Chain<StepEffect>* ec =
+			step_effects.find(condition.get_predicate(), !is_negated(condition));
+			ec != NULL; ec = ec->tail) {
+			link_threat(unsafes, num_unsafes, link, *ec->head.step, *ec->head.effect,
+				orderings, bindings);
 		}
 	}
 }
 
-// Finds the mutex threats by the given step.
-static void mutex_threats(const Chain<MutexThreat>*& mutex_threats,
+// Order of a link and an effect, by link first (newest first) and effect second.
+static bool link_major(const pair<const LinkCondition*, size_t>& c1,
+	const pair<const LinkCondition*, size_t>& c2) {
+	if (c1.first->link_no != c2.first->link_no) {
+		return c1.first->link_no > c2.first->link_no;
+	}
+	return c1.second < c2.second;
+}
+
+// Find the threatened links by the given step.  The given index covers a
+// tail of the given chain of links, and only links with the predicate of
+// an effect and the opposite polarity are looked up in it.
+static void step_threats(const FlawSet<Unsafe>*& unsafes, size_t& num_unsafes,
+	const Step& step, const Chain<Link>* links,
+	const PredicateIndex<LinkCondition>& link_conditions,
+	const Orderings& orderings,
+	const Bindings& bindings) {
+	const EffectList& effects = step.get_action().get_effects();
+	const Chain<Link>* lc = links;
+	for (; lc != NULL && lc != link_conditions.get_source(); lc = lc->tail) {
+		for (EffectList::const_iterator ei = effects.begin();
+			ei != effects.end(); ei++) {
+			link_threat(unsafes, num_unsafes, lc->head, step, **ei, orderings, bindings);
+		}
+	}
+	if (lc != NULL) {
+		// Candidate links and effects, visited in the order of the chain of links.
+		vector<pair<const LinkCondition*, size_t> > candidates;
+		for (size_t i = 0; i < effects.size(); i++) {
+			const Literal& literal = effects[i]->get_literal();
+			for (const Chain<LinkCondition>* cc =
+				link_conditions.find(literal.get_predicate(), !is_negated(literal));
+				cc != NULL; cc = cc->tail) {
+				candidates.push_back(make_pair(&cc->head, i));
+			}
+		}
+		sort(candidates.begin(), candidates.end(), link_major);
+		for (size_t i = 0; i < candidates.size(); i++) {
+			link_threat(unsafes, num_unsafes, *candidates[i].first->link, step,
+				*effects[candidates[i].second], orderings, bindings);
+		}
+	}
+}
+
+// Add a mutex threat if the given effects of the given steps may interfere.
+static void mutex_threat(const FlawSet<MutexThreat>*& mutex_threats,
+	const Step& step, const Effect& e, const Step& s, const Effect& e2,
+	const Orderings& orderings,
+	const Bindings& bindings) {
+	bool ss, se, es, ee;
+	if (orderings.possibly_concurrent(step.get_id(), s.get_id(), ss, se, es, ee)) {
+		bool concurrent;
+		if (e.get_when() == EffectTime::AT_START) {
+			concurrent = (e2.get_when() == EffectTime::AT_START) ? ss : se;
+		}
+		else {
+			concurrent = (e2.get_when() == EffectTime::AT_START) ? es : ee;
+		}
+		if (concurrent
+			&& bindings.unify(e.get_literal().get_atom(), step.get_id(),
+				e2.get_literal().get_atom(), s.get_id())) {
+			mutex_threats = FlawSet<MutexThreat>::add(mutex_threats,
+				MutexThreat(step.get_id(), e, s.get_id(), e2));
+		}
+	}
+}
+
+// Order of a step effect and an effect, by step first (newest first) and effects second.
+static bool step_major(const pair<const StepEffect*, size_t>& c1,
+	const pair<const StepEffect*, size_t>& c2) {
+	if (c1.first->step_no != c2.first->step_no) {
+		return c1.first->step_no > c2.first->step_no;
+	}
+	if (c1.second != c2.second) {
+		return c1.second < c2.second;
+	}
+	return c1.first->effect_no < c2.first->effect_no;
+}
+
+// Finds the mutex threats by the given step.  The given index covers a
+// tail of the given chain of steps, and only effects with the predicate
+// of an effect of the given step are looked up in it.
+static void mutex_threats(const FlawSet<MutexThreat>*& mutex_threats,
 	const Step& step, const Chain<Step>* steps,
+	const PredicateIndex<StepEffect>& step_effects,
 	const Orderings& orderings,
 	const Bindings& bindings) {
 	const EffectList& effects = step.get_action().get_effects();
-	for (const Chain<Step>* sc = steps; sc != NULL; sc = sc->tail) {
+	const Chain<Step>* sc = steps;
+	for (; sc != NULL && sc != step_effects.get_source(); sc = sc->tail) {
 		const Step& s = sc->head;
-		bool ss, se, es, ee;
-		if (orderings.possibly_concurrent(step.get_id(), s.get_id(), ss, se, es, ee)) {
-			const EffectList& effects2 = s.get_action().get_effects();
-			for (EffectList::const_iterator ei = effects.begin();
-				ei != effects.end(); ei++) {
-				const Effect& e = **ei;
-				if (e.get_when() == EffectTime::AT_START) {
-					if (!ss && !se) {
-						continue;
-					}
-				}
-				else if (!es && !ee) {
-					continue;
-				}
-				for (EffectList::const_iterator ej = effects2.begin();
-					ej != effects2.end(); ej++) {
-					const Effect& e2 = **ej;
-					if (e.get_when() == EffectTime::AT_START) {
-						if (e2.get_when() == EffectTime::AT_START) {
-							if (!ss) {
-								continue;
-							}
-						}
-						else if (!se) {
-							continue;
-						}
-					}
-					else {
-						if (e2.get_when() == EffectTime::AT_START) {
-							if (!es) {
-								continue;
-							}
-						}
-						else if (!ee) {
-							continue;
-						}
-					}
-					if (bindings.unify(e.get_literal().get_atom(), step.get_id(),
-						e2.get_literal().get_atom(), s.get_id())) {
-						mutex_threats = new Chain<MutexThreat>(MutexThreat(step.get_id(), e,
-							s.get_id(), e2),
-							mutex_threats);
-					}
+		const EffectList& effects2 = s.get_action().get_effects();
+		for (EffectList::const_iterator ei = effects.begin();
+			ei != effects.end(); ei++) {
+			for (EffectList::const_iterator ej = effects2.begin();
+				ej != effects2.end(); ej++) {
+				mutex_threat(mutex_threats, step, **ei, s, **ej, orderings, bindings);
+			}
+		}
+	}
+	if (sc != NULL) {
+		// Candidate step effects and effects, visited in the order of the chain of steps.
+		vector<pair<const StepEffect*, size_t> > candidates;
+		for (size_t i = 0; i < effects.size(); i++) {
+			const Predicate& predicate = effects[i]->get_literal().get_predicate();
+			for (int negated = 0; negated < 2; negated++) {
+				for (const Chain<StepEffect>* ec = step_effects.find(predicate, negated != 0);
+					ec != NULL; ec = ec->tail) {
+					candidates.push_back(make_pair(&ec->head, i));
 				}
 			}
 		}
+		sort(candidates.begin(), candidates.end(), step_major);
+		for (size_t i = 0; i < candidates.size(); i++) {
+			const StepEffect& se = *candidates[i].first;
+			mutex_threat(mutex_threats, step, *effects[candidates[i].second],
+				*se.step, *se.effect, orderings, bindings);
+		}
 	}
 }
 
@@ -439,8 +1216,8 @@ const Plan* Plan::make_initial_plan(const Problem& problem) {
 		goal_action = new ActionSchema("", false);
 		goal_action->set_condition(problem.get_goal());
 	}
-	// Chain of open conditions.
-	const Chain<OpenCondition>* open_conds = NULL;
+	// Set of open conditions.
+	const FlawSet<OpenCondition>* open_conds = NULL;
 	// Number of open conditions.
 	size_t num_open_conds = 0;
 	// Bindings introduced by goal.
@@ -453,9 +1230,9 @@ const Plan* Plan::make_initial_plan(const Problem& problem) {
 		RCObject::destructive_deref(open_conds);
 		return NULL;
 	}
-	// Make chain of mutex threat place holder.
-	const Chain<MutexThreat>* mutex_threats =
-		new Chain<MutexThreat>(MutexThreat(), NULL);
+	// Make set of mutex threat place holder.
+	const FlawSet<MutexThreat>* mutex_threats =
+		FlawSet<MutexThreat>::add(NULL, MutexThreat());
 	// Make chain of initial steps.
 	const Chain<Step>* steps =
 		new Chain<Step>(Step(0, problem.get_init_action()),
@@ -495,6 +1272,9 @@ const Plan* Plan::make_initial_plan(const Problem& problem) {
 
 // Return the next flaw to work on.
 const Flaw& Plan::get_flaw(const FlawSelectionOrder& flaw_order) const {
+	new_step_trials.clear();
+	reuse_step_trials.clear();
+	threat_trials.clear();
 	const Flaw& flaw = flaw_order.select(*this, *problem, planning_graph);
 	if (!params->ground_actions) {
 		const OpenCondition* open_cond = dynamic_cast<const OpenCondition*>(&flaw);
@@ -536,21 +1316,19 @@ void Plan::refinements(PlanList& plans,
 
 // Handle an unsafe link.
 void Plan::handle_unsafe(PlanList& plans, const Unsafe& unsafe) const {
-	BindingList unifier;
-	const Link& link = unsafe.get_link();
-	StepTime lt1 = link.get_effect_time();
-	StepTime lt2 = end_time(link.get_condition_time());
-	StepTime et = end_time(unsafe.get_effect());
-	if (get_orderings().possibly_not_after(link.get_from_id(), lt1,
-		unsafe.get_step_id(), et)
-		&& get_orderings().possibly_not_before(link.get_to_id(), lt2,
-			unsafe.get_step_id(), et)
-		&& bindings->affects(unifier, unsafe.get_effect().get_literal(),
-			unsafe.get_step_id(),
-			link.get_condition(), link.get_to_id())) {
-		separate(plans, unsafe, unifier);
-		promote(plans, unsafe);
-		demote(plans, unsafe);
+	// The threat was most likely checked and its refinements counted while
+	// the flaw was selected; refinements counted as impossible are skipped.
+	const ThreatTrial& trial = check_threat(unsafe, get_orderings(), *bindings);
+	if (trial.real) {
+		if (trial.separable != 0) {
+			separate(plans, unsafe, trial.unifier);
+		}
+		if (trial.promotable != 0) {
+			promote(plans, unsafe);
+		}
+		if (trial.demotable != 0) {
+			demote(plans, unsafe);
+		}
 	}
 	else {
 		// bogus flaw
@@ -572,7 +1350,8 @@ int Plan::separate(PlanList& plans, const Unsafe& unsafe,
 		if (!unsafe.get_effect().quantifies(subst.get_var())) {
 			const Formula& g = Inequality::make(subst.get_var(), subst.get_var_id(),
 				subst.get_term(), subst.get_term_id());
-			const Inequality* neq = dynamic_cast<const Inequality*>(&g);
+			const Inequality* neq = ((g.get_kind() == INEQUALITY_F)
+				? static_cast<const Inequality*>(&g) : NULL);
 			if (neq == 0 || bindings->is_consistent_with(*neq, 0)) {
 				goal = &(*goal || g);
 			}
@@ -617,7 +1396,7 @@ int Plan::separate(PlanList& plans, const Unsafe& unsafe,
 			goal = &(*goal || !effect_cond);
 		}
 	}
-	const Chain<OpenCondition>* new_open_conds = test_only ? NULL : get_open_conds();
+	const FlawSet<OpenCondition>* new_open_conds = test_only ? NULL : get_open_conds();
 	size_t new_num_open_conds = test_only ? 0 : get_num_open_conds();
 	BindingList new_bindings;
 	bool added = add_goal(new_open_conds, new_num_open_conds, new_bindings,
@@ -633,7 +1412,8 @@ int Plan::separate(PlanList& plans, const Unsafe& unsafe,
 				const Orderings* new_orderings = orderings;
 				if (!goal->is_tautology() && planning_graph != NULL) {
 					const TemporalOrderings* to =
-						dynamic_cast<const TemporalOrderings*>(new_orderings);
+						(new_orderings->is_temporal()
+							? static_cast<const TemporalOrderings*>(new_orderings) : NULL);
 					if (to != NULL) {
 						HeuristicValue h, hs;
 						goal->get_heuristic_value(h, hs, *planning_graph, unsafe.get_step_id(),
@@ -719,10 +1499,11 @@ void Plan::new_ordering(PlanList& plans, size_t before_id, StepTime t1,
 void Plan::handle_mutex_threat(PlanList& plans,
 	const MutexThreat& mutex_threat) const {
 	if (mutex_threat.get_step_id1() == 0) {
-		const Chain<MutexThreat>* new_mutex_threats = NULL;
+		const FlawSet<MutexThreat>* new_mutex_threats = NULL;
 		for (const Chain<Step>* sc = get_steps(); sc != NULL; sc = sc->tail) {
 			const Step& s = sc->head;
-			::mutex_threats(new_mutex_threats, s, get_steps(), get_orderings(), *bindings);
+			::mutex_threats(new_mutex_threats, s, get_steps(), *step_effects,
+				get_orderings(), *bindings);
 		}
 		plans.push_back(new Plan(get_steps(), get_num_steps(), get_links(), get_num_links(),
 			get_orderings(), *bindings, get_unsafes(), get_num_unsafes(),
@@ -765,7 +1546,8 @@ void Plan::separate(PlanList& plans, const MutexThreat& mutex_threat,
 				&& !mutex_threat.get_effect2().quantifies(subst.get_var())) {
 				const Formula& g = Inequality::make(subst.get_var(), subst.get_var_id(),
 					subst.get_term(), subst.get_term_id());
-				const Inequality* neq = dynamic_cast<const Inequality*>(&g);
+				const Inequality* neq = ((g.get_kind() == INEQUALITY_F)
+					? static_cast<const Inequality*>(&g) : NULL);
 				if (neq == 0 || bindings->is_consistent_with(*neq, 0)) {
 					goal = &(*goal || g);
 				}
@@ -775,7 +1557,7 @@ void Plan::separate(PlanList& plans, const MutexThreat& mutex_threat,
 				}
 			}
 		}
-		const Chain<OpenCondition>* new_open_conds = get_open_conds();
+		const FlawSet<OpenCondition>* new_open_conds = get_open_conds();
 		size_t new_num_open_conds = get_num_open_conds();
 		BindingList new_bindings;
 		bool added = add_goal(new_open_conds, new_num_open_conds, new_bindings,
@@ -829,7 +1611,7 @@ void Plan::separate(PlanList& plans, const MutexThreat& mutex_threat,
 			else {
 				goal = &!effect_cond;
 			}
-			const Chain<OpenCondition>* new_open_conds = get_open_conds();
+			const FlawSet<OpenCondition>* new_open_conds = get_open_conds();
 			size_t new_num_open_conds = get_num_open_conds();
 			BindingList new_bindings;
 			bool added = add_goal(new_open_conds, new_num_open_conds, new_bindings,
@@ -841,7 +1623,8 @@ void Plan::separate(PlanList& plans, const MutexThreat& mutex_threat,
 					const Orderings* new_orderings = orderings;
 					if (!goal->is_tautology() && planning_graph != NULL) {
 						const TemporalOrderings* to =
-							dynamic_cast<const TemporalOrderings*>(new_orderings);
+							(new_orderings->is_temporal()
+								? static_cast<const TemporalOrderings*>(new_orderings) : NULL);
 						if (to != NULL) {
 							HeuristicValue h, hs;
 							goal->get_heuristic_value(h, hs, *planning_graph, step_id,
@@ -911,15 +1694,38 @@ void Plan::handle_open_condition(PlanList& plans,
 	const OpenCondition& open_cond) const {
 	const Literal* literal = open_cond.literal();
 	if (literal != NULL) {
-		const ActionEffectMap* achievers = literal_achievers(*literal);
-		if (achievers != NULL) {
-			add_step(plans, *literal, open_cond, *achievers);
-			reuse_step(plans, *literal, open_cond, *achievers);
+		AchieverRange achievers = literal_achievers(*literal);
+		if (!achievers.empty()) {
+			// Links whose effects were unified with the condition while
+			// counting refinements for flaw selection are made from the
+			// recorded unifiers, skipping the achievers that did not unify.
+			const TrialLinks* trials = find_trials(new_step_trials, open_cond,
+				bindings->get_serial(), 0);
+			if (trials != NULL) {
+				for (vector<TrialLink>::const_iterator ti = trials->links.begin();
+					ti != trials->links.end(); ti++) {
+					make_link(plans, (*ti).step, *(*ti).effect, *literal, open_cond,
+						(*ti).mgu);
+				}
+			}
+			else {
+				add_step(plans, *literal, open_cond, achievers);
+			}
+			trials = find_trials(reuse_step_trials, open_cond,
+				bindings->get_serial(), get_orderings().get_serial());
+			if (trials != NULL) {
+				for (vector<TrialLink>::const_iterator ti = trials->links.begin();
+					ti != trials->links.end(); ti++) {
+					make_link(plans, (*ti).step, *(*ti).effect, *literal, open_cond,
+						(*ti).mgu);
+				}
+			}
+			else {
+				reuse_step(plans, *literal, open_cond, achievers);
+			}
 		}
-		const Negation* negation = dynamic_cast<const Negation*>(literal);
-		if (negation != NULL) {
-			new_cw_link(plans, problem->get_init_action().get_effects(),
-				*negation, open_cond);
+		if (literal->get_kind() == NEGATION_F) {
+			new_cw_link(plans, *static_cast<const Negation*>(literal), open_cond);
 		}
 	}
 	else {
@@ -948,7 +1754,7 @@ int Plan::handle_disjunction(PlanList& plans, const Disjunction& disj,
 	for (FormulaList::const_iterator fi = disjuncts.begin();
 		fi != disjuncts.end(); fi++) {
 		BindingList new_bindings;
-		const Chain<OpenCondition>* new_open_conds =
+		const FlawSet<OpenCondition>* new_open_conds =
 			test_only ? NULL : get_open_conds()->remove(open_cond);
 		size_t new_num_open_conds = test_only ? 0 : get_num_open_conds() - 1;
 		bool added = add_goal(new_open_conds, new_num_open_conds, new_bindings,
@@ -1015,10 +1821,6 @@ int Plan::handle_inequality(PlanList& plans, const Inequality& neq,
 			count++;
 		}
 	}
-	if (planning_graph == NULL) {
-		delete &d1;
-		delete &d2;
-	}
 	return count;
 }
 
@@ -1037,6 +1839,33 @@ int Plan::handle_inequality(PlanList& plans, const Inequality& neq,
 //	}
 //}
 
+// Handle a literal open condition by reusing an existing step.
+void Plan::reuse_step(PlanList& plans, const Literal& literal,
+	const OpenCondition& open_cond,
+	const AchieverRange& achievers) const {
+	StepTime gt = start_time(open_cond.get_when());
+	for (const Chain<Step>* sc = get_steps(); sc != NULL; sc = sc->tail) {
+		const Step& step = sc->head;
+		if (get_orderings().possibly_before(step.get_id(), StepTime::AT_START,
+			open_cond.get_step_id(), gt)) {
+			const InitEffectIndex* init;
+			const vector<size_t>* candidates;
+			AchieverRange::const_iterator ai;
+			size_t n = step_achievers(init, candidates, ai, step, literal, open_cond,
+				*bindings, achievers);
+			for (size_t k = 0; k < n; k++) {
+				const Effect& effect =
+					(init != NULL) ? init->get_effect(candidates, k) : *ai[k].second;
+				StepTime et = end_time(effect);
+				if (get_orderings().possibly_before(step.get_id(), et,
+					open_cond.get_step_id(), gt)) {
+					new_link(plans, step, effect, literal, open_cond);
+				}
+			}
+		}
+	}
+}
+
 // Add plans to the given plan list with a link from the given step to the given open condition added.
 int Plan::new_link(PlanList& plans, const Step& step, const Effect& effect,
 	const Literal& literal, const OpenCondition& open_cond,
@@ -1052,14 +1881,19 @@ int Plan::new_link(PlanList& plans, const Step& step, const Effect& effect,
 }
 
 // Add plans to the given plan list with a link from the given step to the given open condition added, using the closed world assumption.
-int Plan::new_cw_link(PlanList& plans, const EffectList& effects,
+int Plan::new_cw_link(PlanList& plans,
 	const Negation& negation, const OpenCondition& open_cond,
 	bool test_only = false) const {
 	const Atom& goal = negation.get_atom();
 	const Formula* goals = &Formula::TRUE_FORMULA;
-	for (EffectList::const_iterator ei = effects.begin();
-		ei != effects.end(); ei++) {
-		const Effect& effect = **ei;
+	// Only initial conditions with the objects the goal is bound to can unify with it.
+	const InitEffectIndex* init = find_init_index(init_conditions, goal);
+	const vector<size_t>* candidates = NULL;
+	size_t n = ((init != NULL && init->find_candidates(candidates, goal,
+		open_cond.get_step_id(), *bindings))
+		? init->size(candidates) : 0);
+	for (size_t k = 0; k < n; k++) {
+		const Effect& effect = init->get_effect(candidates, k);
 		BindingList mgu;
 		if (bindings->unify(mgu, effect.get_literal(), 0,
 			goal, open_cond.get_step_id())) {
@@ -1078,7 +1912,7 @@ int Plan::new_cw_link(PlanList& plans, const EffectList& effects,
 		}
 	}
 	BindingList new_bindings;
-	const Chain<OpenCondition>* new_open_conds =
+	const FlawSet<OpenCondition>* new_open_conds =
 		test_only ? NULL : get_open_conds()->remove(open_cond);
 	size_t new_num_open_conds = test_only ? 0 : get_num_open_conds() - 1;
 	bool added = add_goal(new_open_conds, new_num_open_conds, new_bindings,
@@ -1093,12 +1927,12 @@ int Plan::new_cw_link(PlanList& plans, const EffectList& effects,
 		const Bindings* bindings_t = bindings->add(new_bindings, test_only);
 		if (bindings_t != NULL) {
 			if (!test_only) {
-				const Chain<Unsafe>* new_unsafes = get_unsafes();
+				const FlawSet<Unsafe>* new_unsafes = get_unsafes();
 				size_t new_num_unsafes = get_num_unsafes();
 				const Chain<Link>* new_links =
 					new Chain<Link>(Link(0, StepTime::AT_END, open_cond), get_links());
 				link_threats(new_unsafes, new_num_unsafes, new_links->head, get_steps(),
-					get_orderings(), *bindings_t);
+					*step_effects, get_orderings(), *bindings_t);
 				plans.push_back(new Plan(get_steps(), get_num_steps(),
 					new_links, get_num_links() + 1,
 					get_orderings(), *bindings_t,
@@ -1141,7 +1975,7 @@ int Plan::make_link(PlanList& plans, const Step& step, const Effect& effect,
 	}
 
 	// If the effect is conditional, add condition as goal.
-	const Chain<OpenCondition>* new_open_conds =
+	const FlawSet<OpenCondition>* new_open_conds =
 		test_only ? NULL : get_open_conds()->remove(open_cond);
 	size_t new_num_open_conds = test_only ? 0 : get_num_open_conds() - 1;
 	const Formula* cond_goal = &(effect.get_condition() && effect.get_link_condition());
@@ -1229,7 +2063,8 @@ int Plan::make_link(PlanList& plans, const Step& step, const Effect& effect,
 		if (new_orderings != NULL && !cond_goal->is_tautology()
 			&& planning_graph != NULL) {
 			const TemporalOrderings* to =
-				dynamic_cast<const TemporalOrderings*>(new_orderings);
+				(new_orderings->is_temporal()
+					? static_cast<const TemporalOrderings*>(new_orderings) : NULL);
 			if (to != NULL) {
 				HeuristicValue h, hs;
 				cond_goal->get_heuristic_value(h, hs, *planning_graph, step.get_id(),
@@ -1258,16 +2093,16 @@ int Plan::make_link(PlanList& plans, const Step& step, const Effect& effect,
 			new Chain<Link>(Link(step.get_id(), end_time(effect), open_cond), get_links());
 
 		// Find any threats to the newly established link.
-		const Chain<Unsafe>* new_unsafes = get_unsafes();
+		const FlawSet<Unsafe>* new_unsafes = get_unsafes();
 		size_t new_num_unsafes = get_num_unsafes();
 		link_threats(new_unsafes, new_num_unsafes, new_links->head, new_steps,
-			*new_orderings, *bindings_t);
+			*step_effects, *new_orderings, *bindings_t);
 
 		// If this is a new step, find links it threatens.
-		const Chain<MutexThreat>* new_mutex_threats = get_mutex_threats();
+		const FlawSet<MutexThreat>* new_mutex_threats = get_mutex_threats();
 		if (step.get_id() > get_num_steps()) {
 			step_threats(new_unsafes, new_num_unsafes, step,
-				get_links(), *new_orderings, *bindings_t);
+				get_links(), *link_conditions, *new_orderings, *bindings_t);
 		}
 
 		// Add the new plan.
@@ -1281,8 +2116,7 @@ int Plan::make_link(PlanList& plans, const Step& step, const Effect& effect,
 }
 
 // Return plan for given problem.
-const Plan* Plan::plan(const Problem& problem, const Parameters& p,
-	bool last_problem) {
+const Plan* Plan::plan(const Problem& problem, const Parameters& p) {
 	// Set planning parameters.
 	params = &p;
 	// Set current domain.
@@ -1306,19 +2140,19 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 		planning_graph = NULL;
 	}
 	if (!params->ground_actions) {
-		achieves_pred.clear();
-		achieves_neg_pred.clear();
+		PredicateAchieverMap pred_achievers;
+		PredicateAchieverMap neg_pred_achievers;
 		for (ActionSchemaMap::const_iterator ai = domain->get_actions().begin();
 			ai != domain->get_actions().end(); ai++) {
 			const ActionSchema* as = (*ai).second;
 			for (EffectList::const_iterator ei = as->get_effects().begin();
 				ei != as->get_effects().end(); ei++) {
 				const Literal& literal = (*ei)->get_literal();
-				if (typeid(literal) == typeid(Atom)) {
-					achieves_pred[literal.get_predicate()].insert(make_pair(as, *ei));
+				if (literal.get_kind() == ATOM_F) {
+					pred_achievers[literal.get_predicate()].insert(make_pair(as, *ei));
 				}
 				else {
-					achieves_neg_pred[literal.get_predicate()].insert(make_pair(as,
+					neg_pred_achievers[literal.get_predicate()].insert(make_pair(as,
 						*ei));
 				}
 			}
@@ -1327,7 +2161,7 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 		for (EffectList::const_iterator ei = ia.get_effects().begin();
 			ei != ia.get_effects().end(); ei++) {
 			const Literal& literal = (*ei)->get_literal();
-			achieves_pred[literal.get_predicate()].insert(make_pair(&ia, *ei));
+			pred_achievers[literal.get_predicate()].insert(make_pair(&ia, *ei));
 		}
 		for (TimedActionTable::const_iterator ai = problem.get_timed_actions().begin();
 			ai != problem.get_timed_actions().end(); ai++) {
@@ -1335,16 +2169,44 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 			for (EffectList::const_iterator ei = action.get_effects().begin();
 				ei != action.get_effects().end(); ei++) {
 				const Literal& literal = (*ei)->get_literal();
-				if (typeid(literal) == typeid(Atom)) {
-					achieves_pred[literal.get_predicate()].insert(make_pair(&action,
+				if (literal.get_kind() == ATOM_F) {
+					pred_achievers[literal.get_predicate()].insert(make_pair(&action,
 						*ei));
 				}
 				else {
-					achieves_neg_pred[literal.get_predicate()].insert(make_pair(&action,
+					neg_pred_achievers[literal.get_predicate()].insert(make_pair(&action,
 						*ei));
 				}
 			}
 		}
+
+		achieves_pred.clear();
+		for (PredicateAchieverMap::const_iterator pai = pred_achievers.begin();
+			pai != pred_achievers.end(); pai++) {
+			achieves_pred.add((*pai).first.get_index(), (*pai).second);
+		}
+		achieves_neg_pred.clear();
+		for (PredicateAchieverMap::const_iterator pai = neg_pred_achievers.begin();
+			pai != neg_pred_achievers.end(); pai++) {
+			achieves_neg_pred.add((*pai).first.get_index(), (*pai).second);
+		}
+		init_achievers.clear();
+		for (PredicateAchieverMap::const_iterator pai = pred_achievers.begin();
+			pai != pred_achievers.end(); pai++) {
+			pair<AchieverRange::const_iterator, AchieverRange::const_iterator> b =
+				achieves_pred.find((*pai).first.get_index()).equal_range(&ia);
+			for (AchieverRange::const_iterator ei = b.first; ei != b.second; ei++) {
+				index_init_effect(init_achievers, *(*ei).second);
+			}
+		}
+	}
+	init_conditions.clear();
+	const EffectList& init_effects = problem.get_init_action().get_effects();
+	for (EffectList::const_iterator ei = init_effects.begin();
+		ei != init_effects.end(); ei++) {
+		if ((*ei)->get_literal().get_kind() == ATOM_F) {
+			index_init_effect(init_conditions, **ei);
+		}
 	}
 	static_pred_flaw = false;
 
@@ -1356,11 +2218,15 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 	size_t num_static = 0;
 	// Number of dead ends encountered.
 	size_t num_dead_ends = 0;
+	// Number of duplicate plans discarded.
+	size_t num_duplicates = 0;
 
 	// Generated plans for different flaw selection orders.
 	vector<size_t> generated_plans(params->flaw_orders.size(), 0);
 	// Queues of pending plans.
 	vector<PlanQueue> plans(params->flaw_orders.size(), PlanQueue());
+	// Signatures of queued and expanded plans for different flaw selection orders.
+	vector<TranspositionTable> transpositions(params->flaw_orders.size());
 	// Dead plan queues.
 	vector<PlanQueue*> dead_queues;
 	// Construct the initial plan.
@@ -1368,6 +2234,18 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 	if (initial_plan != NULL) {
 		initial_plan->id = 0;
 	}
+	if (initial_plan != NULL && params->parallel_flaw_orders
+		&& params->flaw_orders.size() > 1) {
+		return portfolio_search(*initial_plan);
+	}
+	if (initial_plan != NULL && params->search_threads > 1
+		&& params->search_algorithm == Parameters::A_STAR) {
+		return distributed_search(*initial_plan);
+	}
+	if (initial_plan != NULL
+		&& params->search_algorithm == Parameters::SMA_STAR) {
+		return sma_search(*initial_plan);
+	}
 
 	// Variable for progress bar (number of generated plans).
 	size_t last_dot = 0;
@@ -1381,9 +2259,29 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 	const Plan* current_plan = initial_plan;
 	generated_plans[current_flaw_order]++;
 	num_generated_plans++;
+	if (current_plan != NULL && !current_plan->is_complete()
+		&& params->search_algorithm == Parameters::HILL_CLIMBING) {
+		SearchStatistics stats;
+		const Plan* hc_plan = hill_climbing_search(*initial_plan, stats);
+		generated_plans[current_flaw_order] += stats.num_generated_plans;
+		num_generated_plans += stats.num_generated_plans;
+		num_visited_plans += stats.num_visited_plans;
+		num_static += stats.num_static;
+		num_dead_ends += stats.num_dead_ends;
+		num_duplicates += stats.num_duplicates;
+		if (hc_plan != NULL) {
+			current_plan = hc_plan;
+		}
+		else if (verbosity > 1) {
+			cerr << "hill climbing is stuck, falling back on A*" << endl;
+		}
+	}
 	if (verbosity > 1) {
 		cerr << "using flaw order " << current_flaw_order << endl;
 	}
+	// Whether children are ranked only when they are taken from the queue.
+	bool lazy_evaluation = (params->lazy_evaluation
+		&& params->search_algorithm != Parameters::IDA_STAR);
 	float f_limit;
 	if (current_plan != NULL
 		&& params->search_algorithm == Parameters::IDA_STAR) {
@@ -1394,6 +2292,12 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 	}
 	do {
 		float next_f_limit = numeric_limits<float>::infinity();
+		if (current_plan != NULL && params->duplicate_detection) {
+			for (size_t i = 0; i < transpositions.size(); i++) {
+				transpositions[i].clear();
+				transpositions[i].insert(current_plan->signature());
+			}
+		}
 		while (current_plan != NULL && !current_plan->is_complete()) {
 			// Do a little amortized cleanup of dead queues.
 			for (size_t dq = 0; dq < 4 && !dead_queues.empty(); dq++) {
@@ -1438,6 +2342,9 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 				const Plan& new_plan = **pi;
 				// N.B. Must set id before computing rank, because it may be used.
 				new_plan.id = num_generated_plans;
+				if (lazy_evaluation) {
+					new_plan.inherit_rank(*current_plan);
+				}
 				if (new_plan.primary_rank() != numeric_limits<float>::infinity()
 					&& (generated_plans[current_flaw_order]
 						< params->search_limits[current_flaw_order])) {
@@ -1447,6 +2354,12 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 						delete &new_plan;
 						continue;
 					}
+					if (params->duplicate_detection
+						&& !transpositions[current_flaw_order].insert(new_plan.signature()).second) {
+						num_duplicates++;
+						delete &new_plan;
+						continue;
+					}
 					if (!added && static_pred_flaw) {
 						num_static++;
 					}
@@ -1514,14 +2427,8 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 					if (current_plan != initial_plan) {
 						delete current_plan;
 					}
-					if (plans[current_flaw_order].empty()) {
-						// Problem lacks solution.
-						current_plan = NULL;
-					}
-					else {
-						current_plan = plans[current_flaw_order].top();
-						plans[current_flaw_order].pop();
-					}
+					// N.B. Returns NULL if the problem lacks solution.
+					current_plan = pop_plan(plans[current_flaw_order]);
 				}
 				// Instantiate all actions if the plan is otherwise complete.
 	
@@ -1543,13 +2450,8 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 							current_plan = inst_plan;
 						}
 					}
-					else if (plans[current_flaw_order].empty()) {
-						// Problem lacks solution.
-						current_plan = NULL;
-					}
 					else {
-						current_plan = plans[current_flaw_order].top();
-						plans[current_flaw_order].pop();
+						current_plan = pop_plan(plans[current_flaw_order]);
 					}
 				}
 			}
@@ -1586,29 +2488,820 @@ const Plan* Plan::plan(const Problem& problem, const Parameters& p,
 		}
 		cerr << endl << "Dead ends encountered: " << num_dead_ends
 			<< endl;
-	}
-	
-	// Discard the rest of the plan queue and some other things, unless
-	// this is the last problem in which case we can save time by just
-	// letting the operating system reclaim the memory for us.
-	
-	if (!last_problem) {
-		if (current_plan != initial_plan) {
-			delete initial_plan;
-		}
-		for (size_t i = 0; i < plans.size(); i++) {
-			while (!plans[i].empty()) {
-				delete plans[i].top();
-				plans[i].pop();
-			}
+		if (params->duplicate_detection) {
+			cerr << "Duplicate plans discarded: " << num_duplicates << endl;
 		}
 	}
+	// The rest of the plan queue is left to Plan::cleanup, which releases
+	// all plans of the search at once.
+	
 	// Return last plan, or NULL if problem does not have a solution.
 	return current_plan;
 }
 
+// Search for a complete plan with all flaw selection orders at once, running each order in its own thread.
+const Plan* Plan::portfolio_search(const Plan& initial_plan) {
+	size_t n = params->flaw_orders.size();
+	// Rank the initial plan before the threads share it.
+	initial_plan.primary_rank();
+	if (params->duplicate_detection) {
+		initial_plan.signature();
+	}
+	portfolio_done = false;
+	portfolio_winner = -1;
+	portfolio_error = exception_ptr();
+	// Statistics for each flaw selection order.
+	vector<SearchStatistics> stats(n);
+	// Last plan of each flaw selection order.
+	vector<const Plan*> results(n, NULL);
+	// Search threads.
+	vector<thread> threads;
+	for (size_t i = 0; i < n; i++) {
+		threads.push_back(thread(&Plan::flaw_order_search, ref(results[i]),
+			cref(initial_plan), i, ref(stats[i])));
+	}
+	for (size_t i = 0; i < n; i++) {
+		threads[i].join();
+	}
+
+	// Keep the complete plan of the winning flaw selection order, or else
+	// any plan left incomplete because a search limit was reached.
+	int winner = portfolio_winner;
+	const Plan* current_plan = NULL;
+	if (winner >= 0) {
+		current_plan = results[winner];
+	}
+	else {
+		for (size_t i = 0; i < n && current_plan == NULL; i++) {
+			current_plan = results[i];
+		}
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (results[i] != NULL && results[i] != current_plan
+			&& results[i] != &initial_plan) {
+			delete results[i];
+		}
+	}
+	if (portfolio_error != NULL) {
+		if (current_plan != &initial_plan) {
+			delete current_plan;
+		}
+		delete &initial_plan;
+		rethrow_exception(portfolio_error);
+	}
+	if (verbosity > 0) {
+
+		// Print statistics.
+
+		SearchStatistics total;
+		for (size_t i = 0; i < n; i++) {
+			total.num_generated_plans += stats[i].num_generated_plans;
+			total.num_visited_plans += stats[i].num_visited_plans;
+			total.num_static += stats[i].num_static;
+			total.num_dead_ends += stats[i].num_dead_ends;
+			total.num_duplicates += stats[i].num_duplicates;
+		}
+		cerr << endl << "Plans generated: " << total.num_generated_plans;
+		if (total.num_static > 0) {
+			cerr << " [" << (total.num_generated_plans - total.num_static) << "]";
+		}
+		cerr << endl << "Plans visited: " << total.num_visited_plans;
+		if (total.num_static > 0) {
+			cerr << " [" << (total.num_visited_plans - total.num_static) << "]";
+		}
+		cerr << endl << "Dead ends encountered: " << total.num_dead_ends
+			<< endl;
+		if (params->duplicate_detection) {
+			cerr << "Duplicate plans discarded: " << total.num_duplicates << endl;
+		}
+		for (size_t i = 0; i < n; i++) {
+			cerr << "Flaw order " << i << ": "
+				<< stats[i].num_generated_plans << " generated, "
+				<< stats[i].num_visited_plans << " visited, "
+				<< stats[i].num_dead_ends << " dead ends";
+			if (int(i) == winner) {
+				cerr << " (found plan)";
+			}
+			cerr << endl;
+		}
+	}
+	return current_plan;
+}
+
+// Search for a complete plan using a single flaw selection order, as one
+// thread of a parallel portfolio.  The search gives up as soon as another
+// thread has found a complete plan.
+void Plan::flaw_order_search(const Plan*& result, const Plan& initial_plan,
+	size_t flaw_order, SearchStatistics& stats) {
+	const FlawSelectionOrder& order = params->flaw_orders[flaw_order];
+	size_t search_limit = params->search_limits[flaw_order];
+	// Queue of pending plans.
+	PlanQueue plans;
+	// Signatures of queued and expanded plans.
+	TranspositionTable transpositions;
+	// Whether children are ranked only when they are taken from the queue.
+	bool lazy_evaluation = (params->lazy_evaluation
+		&& params->search_algorithm != Parameters::IDA_STAR);
+	const Plan* current_plan = &initial_plan;
+	try {
+		static_pred_flaw = false;
+		stats.num_generated_plans++;
+		float f_limit;
+		if (params->search_algorithm == Parameters::IDA_STAR) {
+			f_limit = current_plan->primary_rank();
+		}
+		else {
+			f_limit = numeric_limits<float>::infinity();
+		}
+		bool limit_reached = false;
+		do {
+			float next_f_limit = numeric_limits<float>::infinity();
+			if (params->duplicate_detection) {
+				transpositions.clear();
+				transpositions.insert(current_plan->signature());
+			}
+			while (current_plan != NULL && !current_plan->is_complete()
+				&& !portfolio_done) {
+				stats.num_visited_plans++;
+				// List of children to current plan.
+				PlanList refinements;
+				current_plan->refinements(refinements, order);
+				// Add children to queue of pending plans.
+				bool added = false;
+				for (PlanList::const_iterator pi = refinements.begin();
+					pi != refinements.end(); pi++) {
+					const Plan& new_plan = **pi;
+					// N.B. Must set id before computing rank, because it may be used.
+					new_plan.id = stats.num_generated_plans;
+					if (lazy_evaluation) {
+						new_plan.inherit_rank(*current_plan);
+					}
+					if (new_plan.primary_rank() != numeric_limits<float>::infinity()
+						&& stats.num_generated_plans < search_limit) {
+						if (params->search_algorithm == Parameters::IDA_STAR
+							&& new_plan.primary_rank() > f_limit) {
+							next_f_limit = min(next_f_limit, new_plan.primary_rank());
+							delete &new_plan;
+							continue;
+						}
+						if (params->duplicate_detection
+							&& !transpositions.insert(new_plan.signature()).second) {
+							stats.num_duplicates++;
+							delete &new_plan;
+							continue;
+						}
+						if (!added && static_pred_flaw) {
+							stats.num_static++;
+						}
+						added = true;
+						plans.push(&new_plan);
+						stats.num_generated_plans++;
+					}
+					else {
+						delete &new_plan;
+					}
+				}
+				if (!added) {
+					stats.num_dead_ends++;
+				}
+				if (stats.num_generated_plans >= search_limit) {
+					// Give up, but keep the current plan as the result.
+					limit_reached = true;
+					break;
+				}
+
+				// Process next plan.
+				if (current_plan != &initial_plan) {
+					delete current_plan;
+				}
+				current_plan = pop_plan(plans);
+				// Instantiate all actions if the plan is otherwise complete.
+				bool instantiated = params->ground_actions;
+				while (current_plan != NULL && current_plan->is_complete()
+					&& !instantiated) {
+					const Bindings* new_bindings =
+						step_instantiation(current_plan->get_steps(), 0,
+							*current_plan->bindings);
+					if (new_bindings != NULL) {
+						instantiated = true;
+						if (new_bindings != current_plan->bindings) {
+							const Plan* inst_plan =
+								new Plan(current_plan->get_steps(), current_plan->get_num_steps(),
+									current_plan->get_links(), current_plan->get_num_links(),
+									current_plan->get_orderings(), *new_bindings,
+									NULL, 0, NULL, 0, NULL, current_plan);
+							delete current_plan;
+							current_plan = inst_plan;
+						}
+					}
+					else {
+						delete current_plan;
+						current_plan = pop_plan(plans);
+					}
+				}
+			}
+			if (limit_reached || portfolio_done
+				|| (current_plan != NULL && current_plan->is_complete())) {
+				break;
+			}
+			f_limit = next_f_limit;
+			if (f_limit != numeric_limits<float>::infinity()) {
+				// Restart search.
+				current_plan = &initial_plan;
+			}
+		} while (f_limit != numeric_limits<float>::infinity());
+
+		if (current_plan != NULL && current_plan->is_complete()) {
+			// Claim the win, unless another thread got there first.
+			int no_winner = -1;
+			portfolio_winner.compare_exchange_strong(no_winner, int(flaw_order));
+			portfolio_done = true;
+		}
+		else if (!limit_reached && current_plan != NULL) {
+			// Search was cancelled.
+			if (current_plan != &initial_plan) {
+				delete current_plan;
+			}
+			current_plan = NULL;
+		}
+	}
+	catch (...) {
+		lock_guard<mutex> lock(portfolio_lock);
+		if (portfolio_error == NULL) {
+			portfolio_error = current_exception();
+		}
+		portfolio_done = true;
+		if (current_plan != &initial_plan) {
+			delete current_plan;
+		}
+		current_plan = NULL;
+	}
+	result = current_plan;
+}
+
+// Search for a complete plan with enforced hill climbing, always moving
+// to a plan ranked better than the current one.  When no child of the
+// current plan is better, a breadth-first search below the current plan
+// looks for a better plan, generating at most HILL_CLIMBING_LOOKAHEAD
+// plans before giving up.  The initial plan is never deleted, so that the
+// caller can fall back on a complete search.
+const Plan* Plan::hill_climbing_search(const Plan& initial_plan,
+	SearchStatistics& stats) {
+	const FlawSelectionOrder& order = params->flaw_orders[0];
+	size_t search_limit = params->search_limits[0];
+	const Plan* current_plan = &initial_plan;
+	// Breadth-first queue of plans below the current plan.
+	queue<const Plan*> plateau;
+	// Signatures of the plans generated below the current plan.
+	TranspositionTable transpositions;
+	static_pred_flaw = false;
+	while (current_plan != NULL) {
+		float current_rank = current_plan->primary_rank();
+		plateau.push(current_plan);
+		if (params->duplicate_detection) {
+			transpositions.clear();
+			transpositions.insert(current_plan->signature());
+		}
+		// Better plan found below the current plan.
+		const Plan* next_plan = NULL;
+		size_t lookahead = 0;
+		while (!plateau.empty() && next_plan == NULL
+			&& lookahead < HILL_CLIMBING_LOOKAHEAD
+			&& stats.num_generated_plans < search_limit) {
+			const Plan* plan = plateau.front();
+			plateau.pop();
+			stats.num_visited_plans++;
+			// List of children to plan.
+			PlanList refinements;
+			plan->refinements(refinements, order);
+			// Commit to the best child that is better than the current plan,
+			// and queue the others for the breadth-first search.
+			bool added = false;
+			for (PlanList::const_iterator pi = refinements.begin();
+				pi != refinements.end(); pi++) {
+				const Plan* new_plan = *pi;
+				// N.B. Must set id before computing rank, because it may be used.
+				new_plan->id = stats.num_generated_plans;
+				if (new_plan->primary_rank() == numeric_limits<float>::infinity()
+					|| stats.num_generated_plans >= search_limit
+					|| (next_plan != NULL && next_plan->is_complete())) {
+					delete new_plan;
+					continue;
+				}
+				if (params->duplicate_detection
+					&& !transpositions.insert(new_plan->signature()).second) {
+					stats.num_duplicates++;
+					delete new_plan;
+					continue;
+				}
+				if (!added && static_pred_flaw) {
+					stats.num_static++;
+				}
+				added = true;
+				stats.num_generated_plans++;
+				lookahead++;
+				if (new_plan->is_complete() && !params->ground_actions) {
+					// Instantiate all actions, or drop the plan if that fails.
+					const Bindings* new_bindings =
+						step_instantiation(new_plan->get_steps(), 0,
+							*new_plan->bindings);
+					if (new_bindings == NULL) {
+						delete new_plan;
+						continue;
+					}
+					else if (new_bindings != new_plan->bindings) {
+						const Plan* inst_plan =
+							new Plan(new_plan->get_steps(), new_plan->get_num_steps(),
+								new_plan->get_links(), new_plan->get_num_links(),
+								new_plan->get_orderings(), *new_bindings,
+								NULL, 0, NULL, 0, NULL, new_plan);
+						inst_plan->id = new_plan->id;
+						inst_plan->rank = new_plan->rank;
+						delete new_plan;
+						new_plan = inst_plan;
+					}
+				}
+				if (new_plan->is_complete()) {
+					// A complete plan ends the search.
+					delete next_plan;
+					next_plan = new_plan;
+				}
+				else if (new_plan->primary_rank() >= current_rank) {
+					plateau.push(new_plan);
+				}
+				else if (next_plan == NULL
+					|| new_plan->primary_rank() < next_plan->primary_rank()) {
+					delete next_plan;
+					next_plan = new_plan;
+				}
+				else {
+					delete new_plan;
+				}
+			}
+			if (!added) {
+				stats.num_dead_ends++;
+			}
+			if (plan != &initial_plan) {
+				delete plan;
+			}
+		}
+		// Discard the rest of the breadth-first search.
+		while (!plateau.empty()) {
+			if (plateau.front() != &initial_plan) {
+				delete plateau.front();
+			}
+			plateau.pop();
+		}
+		if (next_plan != NULL && next_plan->is_complete()) {
+			return next_plan;
+		}
+		current_plan = next_plan;
+	}
+	return NULL;
+}
+
+// Raise the f-values of the given node of a memory-bounded search and its ancestors to the lowest f-value of their children.
+static void sma_backup(SmaNode* node) {
+	while (node != NULL && !node->children.empty()) {
+		float f = node->forgotten_f;
+		for (vector<SmaNode*>::const_iterator ci = node->children.begin();
+			ci != node->children.end(); ci++) {
+			f = min(f, (*ci)->f);
+		}
+		if (f <= node->f) {
+			break;
+		}
+		node->f = f;
+		node = node->parent;
+	}
+}
+
+// Remove the given leaf from the search tree of a memory-bounded search,
+// remembering its f-value in its parent.  The leaf is either still in the
+// set of leaves with the f-value it was inserted with, or has already been
+// erased from it, since the set cannot find a node whose f-value changed.
+static void sma_prune(SmaNode* leaf, SmaLeaves& leaves, size_t& num_nodes) {
+	leaves.erase(leaf);
+	SmaNode* parent = leaf->parent;
+	parent->forgotten_f = min(parent->forgotten_f, leaf->f);
+	parent->children.erase(find(parent->children.begin(),
+		parent->children.end(), leaf));
+	delete leaf->plan;
+	delete leaf;
+	num_nodes--;
+	if (parent->children.empty()) {
+		// The parent is a leaf again, and its children are regenerated if it is selected.
+		parent->f = max(parent->f, parent->forgotten_f);
+		leaves.insert(parent);
+	}
+	else {
+		sma_backup(parent);
+	}
+}
+
+// Search for a complete plan with simplified memory-bounded A*.  The
+// search keeps at most params->memory_limit plans in memory (or the
+// plans on the path to the best leaf, if that is more).  When the limit
+// is exceeded, the worst leaf is pruned and its f-value is backed up into
+// its parent, whose children are all regenerated once every one of them
+// has been pruned and the parent is the best leaf again.
+const Plan* Plan::sma_search(const Plan& initial_plan) {
+	const FlawSelectionOrder& order = params->flaw_orders[0];
+	size_t search_limit = params->search_limits[0];
+	SearchStatistics stats;
+	// Number of plans pruned because of the memory limit.
+	size_t num_pruned = 0;
+	// Root of the search tree.
+	SmaNode* root = new SmaNode(&initial_plan, NULL, initial_plan.primary_rank());
+	// Number of nodes in the search tree.
+	size_t num_nodes = 1;
+	// Leaves of the search tree.
+	SmaLeaves leaves;
+	leaves.insert(root);
+	stats.num_generated_plans++;
+	static_pred_flaw = false;
+	const Plan* current_plan = NULL;
+	while (!leaves.empty()) {
+		SmaNode* node = *leaves.begin();
+		if (node->f == numeric_limits<float>::infinity()) {
+			// Problem lacks solution.
+			break;
+		}
+		if (node->plan->is_complete()) {
+			// Instantiate all actions if the plan is otherwise complete.
+			const Bindings* new_bindings = node->plan->bindings;
+			if (!params->ground_actions) {
+				new_bindings = step_instantiation(node->plan->get_steps(), 0,
+					*node->plan->bindings);
+			}
+			if (new_bindings == node->plan->bindings) {
+				current_plan = node->plan;
+				break;
+			}
+			else if (new_bindings != NULL) {
+				current_plan =
+					new Plan(node->plan->get_steps(), node->plan->get_num_steps(),
+						node->plan->get_links(), node->plan->get_num_links(),
+						node->plan->get_orderings(), *new_bindings,
+						NULL, 0, NULL, 0, NULL, node->plan);
+				break;
+			}
+			else if (node == root) {
+				break;
+			}
+			else {
+				// The leaf must leave the f-ordered set before its f-value changes.
+				leaves.erase(node);
+				node->f = numeric_limits<float>::infinity();
+				sma_prune(node, leaves, num_nodes);
+				continue;
+			}
+		}
+
+		// Expand the best leaf.
+		stats.num_visited_plans++;
+		leaves.erase(node);
+		node->forgotten_f = numeric_limits<float>::infinity();
+		// List of children to current plan.
+		PlanList refinements;
+		node->plan->refinements(refinements, order);
+		bool added = false;
+		for (PlanList::const_iterator pi = refinements.begin();
+			pi != refinements.end(); pi++) {
+			const Plan& new_plan = **pi;
+			// N.B. Must set id before computing rank, because it may be used.
+			new_plan.id = stats.num_generated_plans;
+			if (new_plan.primary_rank() != numeric_limits<float>::infinity()
+				&& stats.num_generated_plans < search_limit) {
+				if (!added && static_pred_flaw) {
+					stats.num_static++;
+				}
+				added = true;
+				stats.num_generated_plans++;
+				// A child is never ranked better than its parent.
+				SmaNode* child = new SmaNode(&new_plan, node,
+					max(new_plan.primary_rank(), node->f));
+				node->children.push_back(child);
+				leaves.insert(child);
+				num_nodes++;
+			}
+			else {
+				delete &new_plan;
+			}
+		}
+		if (stats.num_generated_plans >= search_limit) {
+			// Give up, but keep the current plan as the result.
+			current_plan = node->plan;
+			break;
+		}
+		if (!added) {
+			stats.num_dead_ends++;
+			node->f = numeric_limits<float>::infinity();
+			if (node == root) {
+				break;
+			}
+			sma_prune(node, leaves, num_nodes);
+			continue;
+		}
+		sma_backup(node);
+
+		// Prune the worst leaves until the search tree fits in memory,
+		// but never the best leaf.
+		while (num_nodes > params->memory_limit && leaves.size() > 1) {
+			sma_prune(*leaves.rbegin(), leaves, num_nodes);
+			num_pruned++;
+		}
+	}
+
+	// Delete the search tree; the plans in it are released by Plan::cleanup.
+	vector<SmaNode*> nodes(1, root);
+	while (!nodes.empty()) {
+		SmaNode* node = nodes.back();
+		nodes.pop_back();
+		nodes.insert(nodes.end(), node->children.begin(), node->children.end());
+		delete node;
+	}
+	if (verbosity > 0) {
+
+		// Print statistics.
+
+		cerr << endl << "Plans generated: " << stats.num_generated_plans;
+		if (stats.num_static > 0) {
+			cerr << " [" << (stats.num_generated_plans - stats.num_static) << "]";
+		}
+		cerr << endl << "Plans visited: " << stats.num_visited_plans;
+		if (stats.num_static > 0) {
+			cerr << " [" << (stats.num_visited_plans - stats.num_static) << "]";
+		}
+		cerr << endl << "Dead ends encountered: " << stats.num_dead_ends
+			<< endl;
+		cerr << "Plans pruned: " << num_pruned << endl;
+	}
+	return current_plan;
+}
+
+// Search for a complete plan with hash-distributed parallel A*.
+const Plan* Plan::distributed_search(const Plan& initial_plan) {
+	DistributedSearch search(params->search_threads, params->search_limits[0]);
+	search.num_generated_plans++;
+	search.send(initial_plan.structure_hash() % search.num_threads, &initial_plan);
+	// Search threads.
+	vector<thread> threads;
+	for (size_t i = 0; i < search.num_threads; i++) {
+		threads.push_back(thread(&Plan::distributed_search_thread, ref(search), i));
+	}
+	for (size_t i = 0; i < search.num_threads; i++) {
+		threads[i].join();
+	}
+
+	// Return the best complete plan, or else the plan that was being
+	// expanded when the search limit was reached.
+	const Plan* current_plan = search.incumbent;
+	if (current_plan == NULL) {
+		current_plan = search.limit_plan;
+	}
+	else if (search.limit_plan != NULL) {
+		delete search.limit_plan;
+	}
+	if (search.error != NULL) {
+		delete current_plan;
+		rethrow_exception(search.error);
+	}
+	if (verbosity > 0) {
+
+		// Print statistics.
+
+		SearchStatistics total;
+		for (size_t i = 0; i < search.num_threads; i++) {
+			total.num_visited_plans += search.stats[i].num_visited_plans;
+			total.num_static += search.stats[i].num_static;
+			total.num_dead_ends += search.stats[i].num_dead_ends;
+			total.num_duplicates += search.stats[i].num_duplicates;
+		}
+		total.num_generated_plans = min(size_t(search.num_generated_plans), search.search_limit);
+		cerr << endl << "Plans generated: " << total.num_generated_plans;
+		if (total.num_static > 0) {
+			cerr << " [" << (total.num_generated_plans - total.num_static) << "]";
+		}
+		cerr << endl << "Plans visited: " << total.num_visited_plans;
+		if (total.num_static > 0) {
+			cerr << " [" << (total.num_visited_plans - total.num_static) << "]";
+		}
+		cerr << endl << "Dead ends encountered: " << total.num_dead_ends
+			<< endl;
+		if (params->duplicate_detection) {
+			cerr << "Duplicate plans discarded: " << total.num_duplicates << endl;
+		}
+		cerr << "Plans passed between threads: " << search.num_sent - 1 << endl;
+		for (size_t i = 0; i < search.num_threads; i++) {
+			cerr << "Thread " << i << ": "
+				<< search.stats[i].num_visited_plans << " visited" << endl;
+		}
+	}
+	return current_plan;
+}
+
+// Run one thread of a hash-distributed parallel A* search.
+void Plan::distributed_search_thread(DistributedSearch& search, size_t thread_id) {
+	const FlawSelectionOrder& order = params->flaw_orders[0];
+	SearchStatistics& stats = search.stats[thread_id];
+	// Queue of pending plans owned by this thread.
+	PlanQueue plans;
+	// Plans received from other threads.
+	vector<const Plan*> received;
+	// Signatures of queued and expanded plans owned by this thread.
+	TranspositionTable transpositions;
+	try {
+		static_pred_flaw = false;
+		while (!search.done) {
+			// Queue the plans sent to this thread.
+			received.clear();
+			size_t n = search.mailboxes[thread_id].collect(received);
+			for (vector<const Plan*>::const_iterator pi = received.begin();
+				pi != received.end(); pi++) {
+				if (params->duplicate_detection
+					&& !transpositions.insert((*pi)->signature()).second) {
+					stats.num_duplicates++;
+					delete *pi;
+				}
+				else {
+					plans.push(*pi);
+				}
+			}
+			search.best_ranks[thread_id] =
+				plans.empty() ? numeric_limits<float>::infinity() : plans.top()->primary_rank();
+			search.num_received += n;
+			if (plans.empty() || plans.top()->primary_rank() >= search.incumbent_rank) {
+				// Nothing left to do that could improve on the incumbent.  The
+				// last thread to run out of plans finds the search exhausted.
+				if (search.exhausted()) {
+					search.stop();
+				}
+				else {
+					search.wait_for_plans(thread_id);
+				}
+				continue;
+			}
+
+			// Visiting a new plan.
+			const Plan* current_plan = plans.top();
+			plans.pop();
+			if (current_plan->is_complete()) {
+				// Instantiate all actions if the plan is otherwise complete.
+				if (!params->ground_actions) {
+					const Bindings* new_bindings =
+						step_instantiation(current_plan->get_steps(), 0,
+							*current_plan->bindings);
+					if (new_bindings == NULL) {
+						delete current_plan;
+						continue;
+					}
+					else if (new_bindings != current_plan->bindings) {
+						const Plan* inst_plan =
+							new Plan(current_plan->get_steps(), current_plan->get_num_steps(),
+								current_plan->get_links(), current_plan->get_num_links(),
+								current_plan->get_orderings(), *new_bindings,
+								NULL, 0, NULL, 0, NULL, current_plan);
+						inst_plan->id = current_plan->id;
+						inst_plan->rank = current_plan->rank;
+						delete current_plan;
+						current_plan = inst_plan;
+					}
+				}
+				// Keep the plan if it is better than the incumbent.
+				lock_guard<mutex> lock(search.lock);
+				if (current_plan->primary_rank() < search.incumbent_rank) {
+					delete search.incumbent;
+					search.incumbent = current_plan;
+					search.incumbent_rank = current_plan->primary_rank();
+				}
+				else {
+					delete current_plan;
+				}
+				continue;
+			}
+			stats.num_visited_plans++;
+			// List of children to current plan.
+			PlanList refinements;
+			current_plan->refinements(refinements, order);
+			// Pass children on to the threads that own them.
+			bool added = false;
+			for (PlanList::const_iterator pi = refinements.begin();
+				pi != refinements.end(); pi++) {
+				const Plan& new_plan = **pi;
+				// N.B. Must set id before computing rank, because it may be used.
+				new_plan.id = search.next_plan_id.fetch_add(1);
+				if (new_plan.primary_rank() != numeric_limits<float>::infinity()
+					&& new_plan.primary_rank() < search.incumbent_rank
+					&& search.num_generated_plans < search.search_limit) {
+					size_t owner = new_plan.structure_hash() % search.num_threads;
+					if (owner == thread_id && params->duplicate_detection
+						&& !transpositions.insert(new_plan.signature()).second) {
+						stats.num_duplicates++;
+						delete &new_plan;
+						continue;
+					}
+					// Another thread may have reached the limit since it was checked.
+					if (search.num_generated_plans.fetch_add(1) >= search.search_limit) {
+						delete &new_plan;
+						continue;
+					}
+					if (!added && static_pred_flaw) {
+						stats.num_static++;
+					}
+					added = true;
+					if (owner == thread_id) {
+						plans.push(&new_plan);
+					}
+					else {
+						search.send(owner, &new_plan);
+					}
+				}
+				else {
+					delete &new_plan;
+				}
+			}
+			if (!added) {
+				stats.num_dead_ends++;
+			}
+			if (search.num_generated_plans >= search.search_limit) {
+				// Give up, but keep the current plan in case no complete plan was found.
+				lock_guard<mutex> lock(search.lock);
+				if (search.limit_plan == NULL) {
+					search.limit_plan = current_plan;
+				}
+				else {
+					delete current_plan;
+				}
+				search.stop();
+				break;
+			}
+			delete current_plan;
+		}
+	}
+	catch (...) {
+		lock_guard<mutex> lock(search.lock);
+		if (search.error == NULL) {
+			search.error = current_exception();
+		}
+		search.stop();
+	}
+}
+
+// Return a hash value for the structure of this plan.
+size_t Plan::structure_hash() const {
+	if (params->duplicate_detection) {
+		// Duplicates must have the same owner to be detected.
+		return size_t(signature().h2);
+	}
+	size_t h = get_num_steps();
+	for (const Chain<Step>* sc = get_steps(); sc != NULL; sc = sc->tail) {
+		h = 31 * h + sc->head.get_action().get_id();
+	}
+	for (const Chain<Link>* lc = get_links(); lc != NULL; lc = lc->tail) {
+		const Link& l = lc->head;
+		h = 31 * h + l.get_from_id();
+		h = 31 * h + l.get_to_id();
+		h = 31 * h + size_t(&l.get_condition());
+	}
+	h = 31 * h + get_num_open_conds();
+	h = 31 * h + get_num_unsafes();
+	return h ^ (h >> 16);
+}
+
+// Destroy the head of a chain node that is still alive when its pool is released.
+template<class T>
+static void finalize_chain(Chain<T>* chain) {
+	chain->head.~T();
+}
+
+// Destroy the flaw of a flaw set node that is still alive when its pool is released.
+template<class T>
+static void finalize_flaws(FlawSet<T>* set) {
+	set->flaw.~T();
+}
+
+// Release the constraints, indices and rank of a plan that is still alive
+// when the plan pool is released.  The chains and flaw sets of the plan
+// are released with their own pools, so they are left alone.
+void Plan::finalize(Plan* plan) {
+	Orderings::unregister_use(plan->orderings);
+	Bindings::unregister_use(plan->bindings);
+	RCObject::destructive_deref(plan->step_effects);
+	RCObject::destructive_deref(plan->link_conditions);
+	vector<float>().swap(plan->rank);
+}
+
 // Clean up after planning.
 void Plan::cleanup() {
+	// Release all plans, chains and flaw sets of the last search at once, rather than
+	// freeing them one node at a time.
+	SlabPool<Plan>::release(&Plan::finalize);
+	SlabPool<Chain<Step> >::release(&finalize_chain<Step>);
+	SlabPool<Chain<Link> >::release(&finalize_chain<Link>);
+	SlabPool<FlawSet<Unsafe> >::release(&finalize_flaws<Unsafe>);
+	SlabPool<FlawSet<OpenCondition> >::release(&finalize_flaws<OpenCondition>);
+	SlabPool<FlawSet<MutexThreat> >::release(&finalize_flaws<MutexThreat>);
 	if (planning_graph != NULL) {
 		delete planning_graph;
 		planning_graph = NULL;
@@ -1631,6 +3324,8 @@ Plan::~Plan() {
 	RCObject::destructive_deref(unsafes);
 	RCObject::destructive_deref(open_conds);
 	RCObject::destructive_deref(mutex_threats);
+	RCObject::destructive_deref(step_effects);
+	RCObject::destructive_deref(link_conditions);
 }
 
 // Return the bindings of this plan.
@@ -1652,11 +3347,178 @@ float Plan::primary_rank() const {
 	return rank[0];
 }
 
+// Give this plan a provisional rank based on the rank of its parent.  The
+// whole parent rank is kept, so every component means the same as in a
+// real rank and provisional and real ranks compare component by component.
+// Siblings are then ordered by their number of flaws and, failing that,
+// by their ids; a real rank does not have these components, so they are
+// only compared between provisional ranks.
+void Plan::inherit_rank(const Plan& parent) const {
+	parent.primary_rank();
+	rank = parent.rank;
+	rank.push_back(float(get_num_open_conds() + get_num_unsafes()));
+	rank.push_back(float(id));
+	provisional_rank = true;
+}
+
+// Replace a provisional rank of this plan with its real rank, and return true if the rank was provisional.
+bool Plan::update_rank() const {
+	if (!provisional_rank) {
+		return false;
+	}
+	rank.clear();
+	provisional_rank = false;
+	primary_rank();
+	return true;
+}
+
 // Return the serial number of this plan.
 size_t Plan::get_serial_no() const {
 	return id;
 }
 
+// Mix the bits of the given word.
+static unsigned long long mix_bits(unsigned long long x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// Append the given groups of words to the given signature, sorted so that the order of the groups does not matter.
+static void add_sorted_words(vector<size_t>& sig,
+	vector<vector<size_t> >& groups) {
+	sort(groups.begin(), groups.end());
+	sig.push_back(groups.size());
+	for (vector<vector<size_t> >::const_iterator gi = groups.begin();
+		gi != groups.end(); gi++) {
+		sig.insert(sig.end(), (*gi).begin(), (*gi).end());
+	}
+}
+
+// Return the words describing the given link, with step ids renumbered by the given map.
+static vector<size_t> link_words(const Link& link,
+	map<size_t, size_t>& step_ids) {
+	vector<size_t> words;
+	words.push_back(step_ids[link.get_from_id()]);
+	words.push_back(link.get_effect_time().point);
+	words.push_back(link.get_effect_time().rel);
+	words.push_back(step_ids[link.get_to_id()]);
+	words.push_back(size_t(&link.get_condition()));
+	words.push_back(link.get_condition_time());
+	return words;
+}
+
+// Return the canonical signature of this plan, which is shared by all duplicates of this plan.
+const PlanSignature& Plan::signature() const {
+	if (canonical_signature.h1 != 0) {
+		return canonical_signature;
+	}
+
+	// Describe each step by its action and the links it takes part in, so
+	// that steps can be numbered independently of the order in which they
+	// were added.  Steps with equal descriptions keep their relative order,
+	// which can hide a duplicate but never makes two different plans equal.
+	map<size_t, const Action*> actions;
+	for (const Chain<Step>* sc = get_steps(); sc != NULL; sc = sc->tail) {
+		actions[sc->head.get_id()] = &sc->head.get_action();
+	}
+	map<size_t, vector<vector<size_t> > > step_links;
+	for (const Chain<Link>* lc = get_links(); lc != NULL; lc = lc->tail) {
+		const Link& l = lc->head;
+		vector<size_t> words;
+		words.push_back(size_t(&l.get_condition()));
+		words.push_back(l.get_condition_time());
+		words.push_back(l.get_effect_time().point);
+		words.push_back(l.get_effect_time().rel);
+		words.push_back(0);
+		words.push_back(actions[l.get_to_id()]->get_id());
+		step_links[l.get_from_id()].push_back(words);
+		words[4] = 1;
+		words[5] = actions[l.get_from_id()]->get_id();
+		step_links[l.get_to_id()].push_back(words);
+	}
+	vector<pair<vector<size_t>, size_t> > order;
+	for (map<size_t, const Action*>::const_iterator ai = actions.begin();
+		ai != actions.end(); ai++) {
+		size_t step_id = (*ai).first;
+		if (step_id != 0 && step_id != GOAL_ID) {
+			vector<size_t> key;
+			key.push_back((*ai).second->get_id());
+			add_sorted_words(key, step_links[step_id]);
+			order.push_back(make_pair(key, step_id));
+		}
+	}
+	sort(order.begin(), order.end());
+	map<size_t, size_t> step_ids;
+	step_ids[0] = 0;
+	step_ids[GOAL_ID] = GOAL_ID;
+	vector<size_t> steps_in_order;
+	for (size_t i = 0; i < order.size(); i++) {
+		step_ids[order[i].second] = i + 1;
+		steps_in_order.push_back(order[i].second);
+	}
+
+	// Signature words.
+	vector<size_t> sig;
+	sig.push_back(steps_in_order.size());
+	for (vector<size_t>::const_iterator si = steps_in_order.begin();
+		si != steps_in_order.end(); si++) {
+		sig.push_back(actions[*si]->get_id());
+	}
+	vector<vector<size_t> > groups;
+	for (const Chain<Link>* lc = get_links(); lc != NULL; lc = lc->tail) {
+		groups.push_back(link_words(lc->head, step_ids));
+	}
+	add_sorted_words(sig, groups);
+	get_orderings().add_signature(sig, steps_in_order);
+	bindings->add_signature(sig, step_ids);
+	groups.clear();
+	for (FlawSet<OpenCondition>::const_iterator oi(get_open_conds());
+		!oi.at_end(); ++oi) {
+		const OpenCondition& open_cond = *oi;
+		vector<size_t> words;
+		words.push_back(step_ids[open_cond.get_step_id()]);
+		words.push_back(size_t(&open_cond.get_condition()));
+		words.push_back(open_cond.get_when());
+		groups.push_back(words);
+	}
+	add_sorted_words(sig, groups);
+	groups.clear();
+	for (FlawSet<Unsafe>::const_iterator ui(get_unsafes()); !ui.at_end(); ++ui) {
+		const Unsafe& unsafe = *ui;
+		vector<size_t> words = link_words(unsafe.get_link(), step_ids);
+		words.push_back(step_ids[unsafe.get_step_id()]);
+		words.push_back(size_t(&unsafe.get_effect()));
+		groups.push_back(words);
+	}
+	add_sorted_words(sig, groups);
+	groups.clear();
+	for (FlawSet<MutexThreat>::const_iterator mi(get_mutex_threats());
+		!mi.at_end(); ++mi) {
+		const MutexThreat& mutex_threat = *mi;
+		vector<size_t> words;
+		if (mutex_threat.get_step_id1() != 0) {
+			words.push_back(step_ids[mutex_threat.get_step_id1()]);
+			words.push_back(size_t(&mutex_threat.get_effect1()));
+			words.push_back(step_ids[mutex_threat.get_step_id2()]);
+			words.push_back(size_t(&mutex_threat.get_effect2()));
+		}
+		groups.push_back(words);
+	}
+	add_sorted_words(sig, groups);
+
+	// Fold the words into two independent fingerprints.
+	unsigned long long h1 = 0x9e3779b97f4a7c15ULL;
+	unsigned long long h2 = 0xc2b2ae3d27d4eb4fULL;
+	for (vector<size_t>::const_iterator wi = sig.begin(); wi != sig.end(); wi++) {
+		h1 = mix_bits(h1 ^ *wi) + 0x632be59bd9b4e019ULL;
+		h2 = (h2 ^ mix_bits(*wi + 0x8cb92ba72f3d8dd7ULL)) * 0x100000001b3ULL;
+	}
+	canonical_signature.h1 = h1 | 1;
+	canonical_signature.h2 = h2;
+	return canonical_signature;
+}
+
 // Count the number of refinements for the given threat, and returns true iff the number of refinements does not exceed the given limit.
 bool Plan::unsafe_refinements(int& refinements, int& separable,
 	int& promotable, int& demotable,
@@ -1666,32 +3528,30 @@ bool Plan::unsafe_refinements(int& refinements, int& separable,
 	}
 	else {
 		int ref = 0;
-		BindingList unifier;
-		const Link& link = unsafe.get_link();
-		StepTime lt1 = link.get_effect_time();
-		StepTime lt2 = end_time(link.get_condition_time());
-		StepTime et = end_time(unsafe.get_effect());
-		if (get_orderings().possibly_not_after(link.get_from_id(), lt1,
-			unsafe.get_step_id(), et)
-			&& get_orderings().possibly_not_before(link.get_to_id(), lt2,
-				unsafe.get_step_id(), et)
-			&& bindings->affects(unifier, unsafe.get_effect().get_literal(),
-				unsafe.get_step_id(),
-				link.get_condition(), link.get_to_id())) {
+		ThreatTrial& trial = check_threat(unsafe, get_orderings(), *bindings);
+		if (trial.real) {
 			PlanList dummy;
 			if (separable < 0) {
-				separable = separate(dummy, unsafe, unifier, true);
+				separable = unsafe.separable_count().get(bindings->get_serial(), 0);
+				if (separable < 0) {
+					separable = separate(dummy, unsafe, trial.unifier, true);
+					cache_count(unsafe.separable_count(), separable,
+						bindings->get_serial(), 0);
+				}
 			}
+			trial.separable = separable;
 			ref += separable;
 			if (ref <= limit) {
 				if (promotable < 0) {
 					promotable = promote(dummy, unsafe, true);
 				}
+				trial.promotable = promotable;
 				ref += promotable;
 				if (ref <= limit) {
 					if (demotable < 0) {
 						demotable = demote(dummy, unsafe, true);
 					}
+					trial.demotable = demotable;
 					refinements = ref + demotable;
 					return refinements <= limit;
 				}
@@ -1708,21 +3568,17 @@ bool Plan::unsafe_refinements(int& refinements, int& separable,
 
 // Check if the given threat is separable.
 int Plan::is_separable(const Unsafe& unsafe) const {
-	BindingList unifier;
-	const Link& link = unsafe.get_link();
-	StepTime lt1 = link.get_effect_time();
-	StepTime lt2 = end_time(link.get_condition_time());
-	StepTime et = end_time(unsafe.get_effect());
-	if (get_orderings().possibly_not_after(link.get_from_id(), lt1,
-		unsafe.get_step_id(), et)
-		&& get_orderings().possibly_not_before(link.get_to_id(), lt2,
-			unsafe.get_step_id(), et)
-		&& bindings->affects(unifier,
-			unsafe.get_effect().get_literal(),
-			unsafe.get_step_id(),
-			link.get_condition(), link.get_to_id())) {
-		PlanList dummy;
-		return separate(dummy, unsafe, unifier, true);
+	ThreatTrial& trial = check_threat(unsafe, get_orderings(), *bindings);
+	if (trial.real) {
+		int separable = unsafe.separable_count().get(bindings->get_serial(), 0);
+		if (separable < 0) {
+			PlanList dummy;
+			separable = separate(dummy, unsafe, trial.unifier, true);
+			cache_count(unsafe.separable_count(), separable,
+				bindings->get_serial(), 0);
+		}
+		trial.separable = separable;
+		return separable;
 	}
 	else {
 		return 0;
@@ -1807,49 +3663,75 @@ bool Plan::open_cond_refinements(int& refinements, int& addable, int& reusable,
 // Count the number of add-step refinements for the given literal open condition, and returns true iff the number of refinements does not exceed the given limit.
 bool Plan::addable_steps(int& refinements, const Literal& literal,
 	const OpenCondition& open_cond, int limit) const {
-	int count = 0;
+	int count = open_cond.addable_count().get(bindings->get_serial(), 0);
+	if (count >= 0) {
+		refinements = count;
+		return count <= limit;
+	}
+	count = 0;
 	PlanList dummy;
-	const ActionEffectMap* achievers = literal_achievers(literal);
-	if (achievers != NULL) {
-		for (ActionEffectMap::const_iterator ai = achievers->begin();
-			ai != achievers->end(); ai++) {
+	vector<TrialLink> trials;
+	AchieverRange achievers = literal_achievers(literal);
+	if (!achievers.empty()) {
+		for (AchieverRange::const_iterator ai = achievers.begin();
+			ai != achievers.end(); ai++) {
 			const Action& action = *(*ai).first;
-			if (action.get_name().substr(0, 1) != "<") {
+			if (!action.is_pseudo()) {
 				const Effect& effect = *(*ai).second;
-				count += new_link(dummy, Step(get_num_steps() + 1, action), effect,
-					literal, open_cond, true);
-				if (count > limit) {
-					return false;
+				Step step(get_num_steps() + 1, action);
+				BindingList mgu;
+				if (bindings->unify(mgu, effect.get_literal(), step.get_id(),
+					literal, open_cond.get_step_id())) {
+					trials.push_back(TrialLink(step, effect, mgu));
+					count += make_link(dummy, step, effect, literal, open_cond, mgu, true);
+					if (count > limit) {
+						return false;
+					}
 				}
 			}
 		}
 	}
 	refinements = count;
+	cache_count(open_cond.addable_count(), count, bindings->get_serial(), 0);
+	record_trials(new_step_trials, open_cond, trials, bindings->get_serial(), 0);
 	return count <= limit;
 }
 
 // Count the number of reuse-step refinements for the given literal open condition, and returns true iff the number of refinements does not exceed the given limit.
 bool Plan::reusable_steps(int& refinements, const Literal& literal,
 	const OpenCondition& open_cond, int limit) const {
-	int count = 0;
+	int count = open_cond.reusable_count().get(bindings->get_serial(),
+		get_orderings().get_serial());
+	if (count >= 0) {
+		refinements = count;
+		return count <= limit;
+	}
+	count = 0;
 	PlanList dummy;
-	const ActionEffectMap* achievers = literal_achievers(literal);
-	if (achievers != NULL) {
+	vector<TrialLink> trials;
+	AchieverRange achievers = literal_achievers(literal);
+	if (!achievers.empty()) {
 		StepTime gt = start_time(open_cond.get_when());
 		for (const Chain<Step>* sc = get_steps(); sc != NULL; sc = sc->tail) {
 			const Step& step = sc->head;
 			if (get_orderings().possibly_before(step.get_id(), StepTime::AT_START,
 				open_cond.get_step_id(), gt)) {
-				pair<ActionEffectMap::const_iterator,
-					ActionEffectMap::const_iterator> b =
-					achievers->equal_range(&step.get_action());
-				for (ActionEffectMap::const_iterator ei = b.first;
-					ei != b.second; ei++) {
-					const Effect& effect = *(*ei).second;
+				const InitEffectIndex* init;
+				const vector<size_t>* candidates;
+				AchieverRange::const_iterator ai;
+				size_t n = step_achievers(init, candidates, ai, step, literal, open_cond,
+					*bindings, achievers);
+				for (size_t k = 0; k < n; k++) {
+					const Effect& effect =
+						(init != NULL) ? init->get_effect(candidates, k) : *ai[k].second;
 					StepTime et = end_time(effect);
+					BindingList mgu;
 					if (get_orderings().possibly_before(step.get_id(), et,
-						open_cond.get_step_id(), gt)) {
-						count += new_link(dummy, step, effect, literal, open_cond, true);
+						open_cond.get_step_id(), gt)
+						&& bindings->unify(mgu, effect.get_literal(), step.get_id(),
+							literal, open_cond.get_step_id())) {
+						trials.push_back(TrialLink(step, effect, mgu));
+						count += make_link(dummy, step, effect, literal, open_cond, mgu, true);
 						if (count > limit) {
 							return false;
 						}
@@ -1858,21 +3740,24 @@ bool Plan::reusable_steps(int& refinements, const Literal& literal,
 			}
 		}
 	}
-	const Negation* negation = dynamic_cast<const Negation*>(&literal);
-	if (negation != NULL) {
-		count += new_cw_link(dummy, problem->get_init_action().get_effects(),
-			*negation, open_cond, true);
+	if (literal.get_kind() == NEGATION_F) {
+		count += new_cw_link(dummy, *static_cast<const Negation*>(&literal), open_cond,
+			true);
 	}
 	refinements = count;
+	cache_count(open_cond.reusable_count(), count, bindings->get_serial(),
+		get_orderings().get_serial());
+	record_trials(reuse_step_trials, open_cond, trials, bindings->get_serial(),
+		get_orderings().get_serial());
 	return count <= limit;
 }
 
 
 
-// Less-than operator for plans.
+// Less-than operator for plans.  Only the components present in both ranks are compared.
 bool operator<(const Plan& p1, const Plan& p2) {
 	float diff = p1.primary_rank() - p2.primary_rank();
-	for (size_t i = 1; i < p1.rank.size() && diff == 0.0; i++) {
+	for (size_t i = 1; i < p1.rank.size() && i < p2.rank.size() && diff == 0.0; i++) {
 		diff = p1.rank[i] - p2.rank[i];
 	}
 	return diff > 0.0;
@@ -1908,7 +3793,7 @@ ostream& operator<<(ostream& os, const Plan& p) {
 		for (vector<const Step*>::const_iterator si = ordered_steps.begin();
 			si != ordered_steps.end(); si++) {
 			const Step& s = **si;
-			if (s.get_action().get_name().substr(0, 1) != "<") {
+			if (!s.get_action().is_pseudo()) {
 				if (verbosity > 0 || !first) {
 					os << endl;
 				}
@@ -1946,9 +3831,9 @@ ostream& operator<<(ostream& os, const Plan& p) {
 				}
 				os << " : ";
 				step.get_action().print(os, step.get_id(), *bindings);
-				for (const Chain<MutexThreat>* mc = p.get_mutex_threats();
-					mc != NULL; mc = mc->tail) {
-					const MutexThreat& mt = mc->head;
+				for (FlawSet<MutexThreat>::const_iterator mi(p.get_mutex_threats());
+					!mi.at_end(); ++mi) {
+					const MutexThreat& mt = *mi;
 					if (mt.get_step_id1() == step.get_id()) {
 						os << " <" << mt.get_step_id2() << '>';
 					}
@@ -1969,18 +3854,18 @@ ostream& operator<<(ostream& os, const Plan& p) {
 					}
 					os << " -> ";
 					link.get_condition().print(os, link.get_to_id(), *bindings);
-					for (const Chain<Unsafe>* uc = p.get_unsafes();
-						uc != NULL; uc = uc->tail) {
-						const Unsafe& unsafe = uc->head;
+					for (FlawSet<Unsafe>::const_iterator ui(p.get_unsafes());
+						!ui.at_end(); ++ui) {
+						const Unsafe& unsafe = *ui;
 						if (unsafe.get_link() == link) {
 							os << " <" << unsafe.get_step_id() << '>';
 						}
 					}
 				}
 			}
-			for (const Chain<OpenCondition>* occ = p.get_open_conds();
-				occ != NULL; occ = occ->tail) {
-				const OpenCondition& open_cond = occ->head;
+			for (FlawSet<OpenCondition>::const_iterator oi(p.get_open_conds());
+				!oi.at_end(); ++oi) {
+				const OpenCondition& open_cond = *oi;
 				if (open_cond.get_step_id() == step.get_id()) {
 					os << endl << "           ?? -> ";
 					open_cond.get_condition().print(os, open_cond.get_step_id(), *bindings);
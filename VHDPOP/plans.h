@@ -4,6 +4,7 @@
 #include "flaws.h"
 #include "actions.h"
 #include "orderings.h"
+#include "pools.h"
 
 class Parameters;
 class BindingList;
@@ -15,8 +16,13 @@ class EffectList;
 class Action;
 class Problem;
 class Bindings;
-class ActionEffectMap;
+class AchieverRange;
 class FlawSelectionOrder;
+struct SearchStatistics;
+struct DistributedSearch;
+struct StepEffect;
+struct LinkCondition;
+template<class T> class PredicateIndex;
 
 
 //=================== Link ====================
@@ -76,6 +82,11 @@ inline bool operator==(const Link& l1, const Link& l2) {
 	return &l1 == &l2;
 }
 
+// Chains of causal links are drawn from a pool.
+template<>
+struct ChainAllocator<Link> :public PooledAllocator<Chain<Link> > {
+};
+
 
 //=================== Step ====================
 
@@ -102,6 +113,11 @@ public:
 	const Action& get_action() const { return *action; }
 };
 
+// Chains of steps are drawn from a pool.
+template<>
+struct ChainAllocator<Step> :public PooledAllocator<Chain<Step> > {
+};
+
 
 //=================== StepSorter ====================
 
@@ -118,6 +134,32 @@ struct StepSorter {
 };
 
 
+//=================== PlanSignature ====================
+
+// A fingerprint of the canonical form of a plan, which is the same for plans that differ only in the numbering of their steps and the order of their chains.
+struct PlanSignature {
+	// First half of the fingerprint.
+	unsigned long long h1;
+	// Second half of the fingerprint.
+	unsigned long long h2;
+
+	// Construct an empty signature.
+	PlanSignature() : h1(0), h2(0) {}
+};
+
+// Equality operator for plan signatures.
+inline bool operator==(const PlanSignature& s1, const PlanSignature& s2) {
+	return s1.h1 == s2.h1 && s1.h2 == s2.h2;
+}
+
+// Hash function for plan signatures.
+struct PlanSignatureHash {
+	size_t operator()(const PlanSignature& s) const {
+		return size_t(s.h1 ^ (s.h1 >> 32));
+	}
+};
+
+
 //=================== Plan ====================
 
 // A plan.
@@ -139,20 +181,28 @@ private:
 	const Orderings* orderings;
 	// Binding constraints of this plan.
 	const Bindings* bindings;
-	// Chain of potentially threatened links.
-	const Chain<Unsafe>* unsafes;
+	// Set of potentially threatened links.
+	const FlawSet<Unsafe>* unsafes;
 	// Number of potentially threatened links.
 	size_t num_unsafes;
-	// Chain of open conditions.
-	const Chain<OpenCondition>* open_conds;
+	// Set of open conditions.
+	const FlawSet<OpenCondition>* open_conds;
 	// Number of open conditions.
 	const size_t num_open_conds;
-	// Chain of mutex threats.
-	const Chain<MutexThreat>* mutex_threats;
+	// Set of mutex threats.
+	const FlawSet<MutexThreat>* mutex_threats;
+	// Effects of the steps of this plan, indexed by predicate and polarity.
+	const PredicateIndex<StepEffect>* step_effects;
+	// Causal links of this plan, indexed by the predicate and polarity of their conditions.
+	const PredicateIndex<LinkCondition>* link_conditions;
 	// Rank of this plan.
 	mutable vector<float> rank;
+	// Whether the rank of this plan is inherited from its parent rather than computed.
+	mutable bool provisional_rank;
 	// Plan id (serial number).
 	mutable size_t id;
+	// Canonical signature of this plan, or an empty signature if not yet computed.
+	mutable PlanSignature canonical_signature;
 
 #ifdef DEBUG
 	// Depth of this plan in the search space.
@@ -166,9 +216,15 @@ private:
 	Plan(const Chain<Step>* steps, size_t num_steps,
 		const Chain<Link>* links, size_t num_links,
 		const Orderings& orderings, const Bindings& bindings,
-		const Chain<Unsafe>* unsafes, size_t num_unsafes,
-		const Chain<OpenCondition>* open_conds, size_t num_open_conds,
-		const Chain<MutexThreat>* mutex_threats, const Plan* parent);
+		const FlawSet<Unsafe>* unsafes, size_t num_unsafes,
+		const FlawSet<OpenCondition>* open_conds, size_t num_open_conds,
+		const FlawSet<MutexThreat>* mutex_threats, const Plan* parent);
+
+	// Release the constraints, indices and rank of a plan that is still alive when the plan pool is released.
+	static void finalize(Plan* plan);
+
+	// Give this plan a provisional rank based on the rank of its parent.
+	void inherit_rank(const Plan& parent) const;
 
 	// Return the next flaw to work on.
 	const Flaw& get_flaw(const FlawSelectionOrder& flaw_order) const;
@@ -233,11 +289,11 @@ private:
 	// Handle a literal open condition by adding a new step.
 	void add_step(PlanList& plans, const Literal& literal,
 		const OpenCondition& open_cond,
-		const ActionEffectMap& achievers) const {
-		for (ActionEffectMap::const_iterator ai = achievers.begin();
+		const AchieverRange& achievers) const {
+		for (AchieverRange::const_iterator ai = achievers.begin();
 			ai != achievers.end(); ai++) {
 			const Action& action = *(*ai).first;
-			if (action.get_name().substr(0, 1) != "<") {
+			if (!action.is_pseudo()) {
 				const Effect& effect = *(*ai).second;
 				new_link(plans, Step(get_num_steps() + 1, action), effect,
 					literal, open_cond);
@@ -248,35 +304,15 @@ private:
 	// Handle a literal open condition by reusing an existing step.
 	void reuse_step(PlanList& plans, const Literal& literal,
 		const OpenCondition& open_cond,
-		const ActionEffectMap& achievers) const {
-		StepTime gt = start_time(open_cond.get_when());
-		for (const Chain<Step>* sc = get_steps(); sc != NULL; sc = sc->tail) {
-			const Step& step = sc->head;
-			if (get_orderings().possibly_before(step.get_id(), StepTime::AT_START,
-				open_cond.get_step_id(), gt)) {
-				std::pair<ActionEffectMap::const_iterator,
-					ActionEffectMap::const_iterator> b =
-					achievers.equal_range(&step.get_action());
-				for (ActionEffectMap::const_iterator ei = b.first;
-					ei != b.second; ei++) {
-					const Effect& effect = *(*ei).second;
-					StepTime et = end_time(effect);
-					if (get_orderings().possibly_before(step.get_id(), et,
-						open_cond.get_step_id(), gt)) {
-						new_link(plans, step, effect, literal, open_cond);
-					}
-				}
-			}
-		}
-	}
+		const AchieverRange& achievers) const;
 
 	// Add plans to the given plan list with a link from the given step to the given open condition added.
 	int new_link(PlanList& plans, const Step& step, const Effect& effect,
 		const Literal& literal, const OpenCondition& open_cond,
 		bool test_only = false) const;
 
-	// Add plans to the given plan list with a link from the given step to the given open condition added using the closed world assumption.
-	int new_cw_link(PlanList& plans, const EffectList& effects,
+	// Add plans to the given plan list with a link from the initial conditions to the given open condition added using the closed world assumption.
+	int new_cw_link(PlanList& plans,
 		const Negation& negation, const OpenCondition& open_cond,
 		bool test_only = false) const;
 
@@ -285,8 +321,32 @@ private:
 		const Literal& literal, const OpenCondition& open_cond,
 		const BindingList& unifier, bool test_only = false) const;
 
+	// Search for a complete plan with all flaw selection orders at once, running each order in its own thread.
+	static const Plan* portfolio_search(const Plan& initial_plan);
+
+	// Search for a complete plan using a single flaw selection order, as one thread of a parallel portfolio.
+	static void flaw_order_search(const Plan*& result, const Plan& initial_plan,
+		size_t flaw_order, SearchStatistics& stats);
+
+	// Search for a complete plan with hash-distributed parallel A*.
+	static const Plan* distributed_search(const Plan& initial_plan);
+
+	// Run one thread of a hash-distributed parallel A* search.
+	static void distributed_search_thread(DistributedSearch& search, size_t thread_id);
+
+	// Search for a complete plan with enforced hill climbing, and return NULL if the search gets stuck.
+	static const Plan* hill_climbing_search(const Plan& initial_plan,
+		SearchStatistics& stats);
+
+	// Search for a complete plan with simplified memory-bounded A*.
+	static const Plan* sma_search(const Plan& initial_plan);
+
+	// Return a hash value for the structure of this plan.
+	size_t structure_hash() const;
+
 	friend bool operator<(const Plan& p1, const Plan& p2);
 	friend ostream& operator<<(ostream& os, const Plan& p);
+	friend class PlanQueue;
 
 
 public:
@@ -294,15 +354,24 @@ public:
 	static const size_t GOAL_ID;
 
 	// Return plan for given problem.
-	static const Plan* plan(const Problem& problem, const Parameters& params,
-		bool last_problem);
+	static const Plan* plan(const Problem& problem, const Parameters& params);
 
-	// Cleans up after planning.
+	// Cleans up after planning, releasing all plans, plan chains and flaw sets that are still alive.
 	static void cleanup();
 
 	// Destruct this plan.
 	~Plan();
 
+	// Allocate a plan from the plan pool.
+	static void* operator new(size_t size) {
+		return SlabPool<Plan>::allocate();
+	}
+
+	// Return a plan to the plan pool.
+	static void operator delete(void* p) {
+		SlabPool<Plan>::deallocate(p);
+	}
+
 	// Return the steps of this plan.
 	const Chain<Step>* get_steps() const { return steps; }
 
@@ -322,19 +391,19 @@ public:
 	const Bindings* get_bindings() const;
 
 	// Return the potentially threatened links of this plan.
-	const Chain<Unsafe>* get_unsafes() const { return unsafes; }
+	const FlawSet<Unsafe>* get_unsafes() const { return unsafes; }
 
 	// Return the number of potentially threatened links in this plan.
 	size_t get_num_unsafes() const { return num_unsafes; }
 
 	// Return the open conditions of this plan.
-	const Chain<OpenCondition>* get_open_conds() const { return open_conds; }
+	const FlawSet<OpenCondition>* get_open_conds() const { return open_conds; }
 
 	// Return the number of open conditions in this plan.
 	size_t get_num_open_conds() const { return num_open_conds; }
 
 	// Return the mutex threats of this plan.
-	const Chain<MutexThreat>* get_mutex_threats() const { return mutex_threats; }
+	const FlawSet<MutexThreat>* get_mutex_threats() const { return mutex_threats; }
 
 	// Check if this plan is complete.
 	bool is_complete() const;
@@ -342,9 +411,15 @@ public:
 	// Return the primary rank of this plan, where a lower rank signifies a better plan.
 	float primary_rank() const;
 
+	// Replace a provisional rank of this plan with its real rank, and return true if the rank was provisional.
+	bool update_rank() const;
+
 	// Return the serial number of this plan.
 	size_t get_serial_no() const;
 
+	// Return the canonical signature of this plan, which is shared by all duplicates of this plan.
+	const PlanSignature& signature() const;
+
 #ifdef DEBUG
 	// Return the depth of this plan.
 	size_t depth() const { return depth_; }
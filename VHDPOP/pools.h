@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// Slab pool for objects of a single type.  Objects are carved out of large
+// slabs, and freed objects are kept on a free list of the thread that freed
+// them, so that threads never contend for a lock except when a new slab is
+// needed.  All objects of a search can be released in one go with release,
+// which is much cheaper than freeing them one at a time.
+template<class T>
+class SlabPool {
+	// Number of objects in a slab.
+	static const size_t SLAB_SIZE = 4096;
+
+	// Storage for a single object.
+	struct Slot {
+		// Storage for the object (first, so that an object pointer is a slot pointer).
+		typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+		// Next slot on a free list.
+		Slot* next;
+		// Whether the slot holds a live object.
+		bool live;
+	};
+
+	// Allocation state of a thread.
+	struct ThreadCache {
+		// Generation of the pool this state belongs to.
+		size_t generation;
+		// Slots freed by this thread.
+		Slot* free_list;
+		// Next unused slot of the slab owned by this thread.
+		Slot* next_slot;
+		// End of the slab owned by this thread.
+		Slot* slab_end;
+
+		// Construct empty allocation state.
+		ThreadCache() : generation(0), free_list(0), next_slot(0), slab_end(0) {}
+	};
+
+	// Allocated slabs.
+	static std::vector<Slot*> slabs;
+	// Lock for the allocated slabs.
+	static std::mutex slabs_lock;
+	// Current generation of the pool, incremented by every release.
+	static std::atomic<size_t> generation;
+	// Allocation state of the running thread.
+	static thread_local ThreadCache cache;
+
+	// Return the allocation state of the running thread, discarding it if it belongs to a released generation.
+	static ThreadCache& thread_cache() {
+		size_t g = generation;
+		if (cache.generation != g) {
+			cache = ThreadCache();
+			cache.generation = g;
+		}
+		return cache;
+	}
+
+public:
+	// Return storage for a new object.
+	static void* allocate() {
+		ThreadCache& tc = thread_cache();
+		Slot* slot = tc.free_list;
+		if (slot != 0) {
+			tc.free_list = slot->next;
+		}
+		else {
+			if (tc.next_slot == tc.slab_end) {
+				Slot* slab = new Slot[SLAB_SIZE]();
+				std::lock_guard<std::mutex> lock(slabs_lock);
+				slabs.push_back(slab);
+				tc.next_slot = slab;
+				tc.slab_end = slab + SLAB_SIZE;
+			}
+			slot = tc.next_slot++;
+		}
+		slot->live = true;
+		return slot;
+	}
+
+	// Return the storage of an object that has been destroyed to the pool.
+	static void deallocate(void* p) {
+		if (p != 0) {
+			Slot* slot = static_cast<Slot*>(p);
+			slot->live = false;
+			ThreadCache& tc = thread_cache();
+			slot->next = tc.free_list;
+			tc.free_list = slot;
+		}
+	}
+
+	// Release all storage of the pool, after calling the given function on every object that is still live.  No thread may be using the pool.
+	static void release(void (*finalize)(T*)) {
+		std::lock_guard<std::mutex> lock(slabs_lock);
+		for (size_t i = 0; i < slabs.size(); i++) {
+			Slot* slab = slabs[i];
+			if (finalize != 0) {
+				for (size_t j = 0; j < SLAB_SIZE; j++) {
+					if (slab[j].live) {
+						finalize(reinterpret_cast<T*>(&slab[j].storage));
+					}
+				}
+			}
+			delete[] slab;
+		}
+		slabs.clear();
+		generation++;
+	}
+};
+
+template<class T>
+std::vector<typename SlabPool<T>::Slot*> SlabPool<T>::slabs;
+
+template<class T>
+std::mutex SlabPool<T>::slabs_lock;
+
+template<class T>
+std::atomic<size_t> SlabPool<T>::generation(1);
+
+template<class T>
+thread_local typename SlabPool<T>::ThreadCache SlabPool<T>::cache;
+
+
+// Allocator drawing objects of a single type from a slab pool.
+template<class T>
+struct PooledAllocator {
+	// Return storage for a new object.
+	static void* allocate(size_t size) {
+		return SlabPool<T>::allocate();
+	}
+
+	// Return the storage of a destroyed object to the pool.
+	static void deallocate(void* p) {
+		SlabPool<T>::deallocate(p);
+	}
+};
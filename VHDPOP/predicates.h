@@ -22,6 +22,9 @@ class Predicate {
 
 public:
 	explicit Predicate(int index) :index(index) {}
+
+	// Return the predicate index.
+	int get_index() const { return index; }
 };
 
 // Equality operator for predicates.
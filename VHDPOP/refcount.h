@@ -1,7 +1,10 @@
 #pragma once
+
+#include <atomic>
+
 class RCObject
 {
-	mutable unsigned long ref_count;	// Reference counter.
+	mutable std::atomic<unsigned long> ref_count;	// Reference counter (atomic, since search threads share objects).
 
 protected:
 	// Construct an object with a reference counter.
@@ -10,6 +13,9 @@ protected:
 	// Copy constructor.
 	RCObject(const RCObject& o) :ref_count(0) {}
 
+	// Assignment operator; the reference counter is not copied.
+	RCObject& operator=(const RCObject& o) { return *this; }
+
 public:
 	// Destructor.
 	virtual ~RCObject() {};
@@ -31,8 +37,7 @@ public:
 	// Decrease the reference count for the given object and delete it if the reference count becomes 0.
 	static void destructive_deref(const RCObject* o) {
 		if (o != 0) {
-			-- o->ref_count;
-			if (o->ref_count == 0) {
+			if (-- o->ref_count == 0) {
 				delete o;
 			}
 		}
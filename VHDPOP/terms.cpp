@@ -1,4 +1,6 @@
 #include "terms.h"
+#include <mutex>
+#include <stdexcept>
 #include <typeinfo>
 
 // Convert the object to a term.
@@ -47,7 +49,16 @@ vector<string> TermTable::names;
 TypeList TermTable::object_types;
 
 // Variable types. 
-TypeList TermTable::variable_types;
+TypeList* TermTable::variable_types[TermTable::VARIABLE_BLOCKS];
+
+// Number of variables.
+size_t TermTable::num_variables = 0;
+
+// Lock serializing the addition of variables.
+static mutex variable_lock;
+
+// Lock for the cached compatible objects of term tables.
+static mutex compatible_lock;
 
 // Destructor. Delete the term table.
 TermTable::~TermTable() {
@@ -56,12 +67,26 @@ TermTable::~TermTable() {
 		compatible.begin(); oi != compatible.end(); oi++) {
 		delete (*oi).second;
 	}
+	for (map<Type, const ObjectSet*>::const_iterator oi =
+		compatible_sets.begin(); oi != compatible_sets.end(); oi++) {
+		delete (*oi).second;
+	}
 }
 
 // Add a fresh variable with the given type to the term table and return it.
 Variable TermTable::add_variable(const Type& type) {
-	variable_types.push_back(type);
-	return Variable(-variable_types.size());
+	lock_guard<mutex> lock(variable_lock);
+	size_t block = num_variables / VARIABLE_BLOCK_SIZE;
+	if (block >= VARIABLE_BLOCKS) {
+		throw runtime_error("too many variables");
+	}
+	if (variable_types[block] == 0) {
+		variable_types[block] = new TypeList();
+		variable_types[block]->reserve(VARIABLE_BLOCK_SIZE);
+	}
+	variable_types[block]->push_back(type);
+	num_variables++;
+	return Variable(-int(num_variables));
 }
 
 // Set the type of the given term.
@@ -70,7 +95,8 @@ void TermTable::set_type(const Term& term, const Type& type) {
 		object_types[term.index] = type;
 	}
 	else {
-		variable_types[-term.index - 1] = type;
+		size_t i = -term.index - 1;
+		(*variable_types[i / VARIABLE_BLOCK_SIZE])[i % VARIABLE_BLOCK_SIZE] = type;
 	}
 }
 
@@ -80,7 +106,8 @@ const Type& TermTable::type(const Term& term) {
 		return object_types[term.index];
 	}
 	else {
-		return variable_types[-term.index - 1];
+		size_t i = -term.index - 1;
+		return (*variable_types[i / VARIABLE_BLOCK_SIZE])[i % VARIABLE_BLOCK_SIZE];
 	}
 }
 
@@ -110,6 +137,28 @@ const Object* TermTable::find_object(const string& name) const {
 
 // Return a list with objects that are compatible with the given type. 
 const ObjectList& TermTable::compatible_objects(const Type& type) const {
+	lock_guard<mutex> lock(compatible_lock);
+	return find_compatible_objects(type);
+}
+
+// Return the set of objects that are compatible with the given type.
+const ObjectSet& TermTable::compatible_object_set(const Type& type) const {
+	lock_guard<mutex> lock(compatible_lock);
+	map<Type, const ObjectSet*>::const_iterator oi = compatible_sets.find(type);
+	if (oi != compatible_sets.end()) {
+		return *(*oi).second;
+	}
+	else {
+		const ObjectList& objects = find_compatible_objects(type);
+		ObjectSet* comp_objects = new ObjectSet();
+		comp_objects->insert(objects.begin(), objects.end());
+		compatible_sets.insert(make_pair(type, comp_objects));
+		return *comp_objects;
+	}
+}
+
+// Return a list with objects that are compatible with the given type; the compatible objects lock must be held.
+const ObjectList& TermTable::find_compatible_objects(const Type& type) const {
 	map<Type, const ObjectList*>::const_iterator oi =
 		compatible.find(type);
 	if (oi != compatible.end()) {
@@ -118,7 +167,7 @@ const ObjectList& TermTable::compatible_objects(const Type& type) const {
 	else {
 		ObjectList* comp_objects;
 		if (parent != 0) {
-			comp_objects = new ObjectList(parent->compatible_objects(type));
+			comp_objects = new ObjectList(parent->find_compatible_objects(type));
 		}
 		else {
 			comp_objects = new ObjectList();
@@ -130,6 +179,7 @@ const ObjectList& TermTable::compatible_objects(const Type& type) const {
 				comp_objects->push_back(o);
 			}
 		}
+		compatible.insert(make_pair(type, comp_objects));
 		return *comp_objects;
 	}
 }
@@ -3,6 +3,7 @@
 #include "types.h"
 #include <iostream>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -66,6 +67,9 @@ public:
 
 	// Convert the term to a variable.  Fail if the term is not a variable.
 	Variable as_variable() const;
+
+	// Return the index of this term.
+	int get_index() const { return index; }
 };
 
 // Equality operator for terms.
@@ -75,7 +79,7 @@ inline bool operator==(const Term& t1, const Term& t2) {
 
 // Inequality operator for terms.
 inline bool operator!=(const Term& t1, const Term& t2) {
-	return t1.index == t2.index;
+	return t1.index != t2.index;
 }
 
 // Less-than operator for terms.
@@ -101,6 +105,11 @@ class ObjectList : public vector<Object> {
 };
 
 
+// Object set: a set of objects.
+class ObjectSet :public set<Object> {
+};
+
+
 // Variable list: a vector of variables.
 class VariableList : public vector<Variable> {
 };
@@ -114,8 +123,17 @@ class TermTable {
 	// Object types. 
 	static TypeList object_types;
 
-	// Variable types. 
-	static TypeList variable_types;
+	// Capacity of each block of variable types.
+	static const size_t VARIABLE_BLOCK_SIZE = 1024;
+
+	// Maximum number of blocks of variable types.
+	static const size_t VARIABLE_BLOCKS = 16384;
+
+	// Variable types, stored in blocks that never move, so that a search thread can read the type of a variable while another thread adds a fresh variable.
+	static TypeList* variable_types[VARIABLE_BLOCKS];
+
+	// Number of variables.
+	static size_t num_variables;
 
 	// Pointer to parent term table. 
 	const TermTable* parent;
@@ -126,6 +144,9 @@ class TermTable {
 	// Cached results of compatible objects queries. 
 	mutable map<Type, const ObjectList*> compatible;
 
+	// Cached results of compatible object set queries.
+	mutable map<Type, const ObjectSet*> compatible_sets;
+
 	friend ostream& operator<<(ostream& os, const TermTable& t);
 	friend ostream& operator<<(ostream& os, const Term& t);
 
@@ -156,4 +177,11 @@ public:
 
 	// Return a list with objects that are compatible with the given type. 
 	const ObjectList& compatible_objects(const Type& type) const;	
+
+	// Return the set of objects that are compatible with the given type.
+	const ObjectSet& compatible_object_set(const Type& type) const;
+
+private:
+	// Return a list with objects that are compatible with the given type; the compatible objects lock must be held.
+	const ObjectList& find_compatible_objects(const Type& type) const;
 };
\ No newline at end of file
@@ -31,10 +31,15 @@ int verbosity;
 static struct option long_options[] = {
 	{ "action-cost", required_argument, NULL, 'a' },
 { "domain-constraints", optional_argument, NULL, 'd' },
+{ "duplicates", no_argument, NULL, 'D' },
+{ "lazy-evaluation", no_argument, NULL, 'e' },
 { "flaw-order", required_argument, NULL, 'f' },
 { "ground-actions", no_argument, NULL, 'g' },
 { "heuristic", required_argument, NULL, 'h' },
+{ "threads", required_argument, NULL, 'j' },
 { "limit", required_argument, NULL, 'l' },
+{ "memory-limit", required_argument, NULL, 'm' },
+{ "parallel", no_argument, NULL, 'P' },
 { "random-open-conditions", no_argument, NULL, 'r' },
 { "search-algorithm", required_argument, NULL, 's' },
 { "seed", required_argument, NULL, 'S' },
@@ -47,7 +52,7 @@ static struct option long_options[] = {
 { "help", no_argument, NULL, '?' },
 { 0, 0, 0, 0 }
 };
-static const char OPTION_STRING[] = "a:d::f:gh:l:rs:S:t:T:v::Vw:W::?";
+static const char OPTION_STRING[] = "a:d::Def:gh:j:l:m:Prs:S:t:T:v::Vw:W::?";
 
 
 /* Displays help. */
@@ -62,14 +67,29 @@ static void display_help() {
 		<< std::endl
 		<< "\t\t\t  otherwise (default) static preconditions are kept"
 		<< std::endl
+		<< "  -D,    --duplicates\t"
+		<< "discard duplicate plans" << std::endl
+		<< "  -e,    --lazy-evaluation" << std::endl
+		<< "\t\t\trank plans only when they are taken from the queue"
+		<< std::endl
 		<< "  -f f,  --flaw-order=f\t"
 		<< "use flaw selection order f" << std::endl
 		<< "  -g,    --ground-actions" << std::endl
 		<< "\t\t\tuse ground actions" << std::endl
 		<< "  -h h,  --heuristic=h\t"
 		<< "use heuristic h to rank plans" << std::endl
+		<< "  -j n,  --threads=n\t"
+		<< "use n threads for A* search" << std::endl
+		<< "\t\t\t(the plan found is the best one only with heuristics"
+		<< std::endl
+		<< "\t\t\tthat never rank a plan below its parent)" << std::endl
 		<< "  -l l,  --limit=l\t"
 		<< "search no more than l plans" << std::endl
+		<< "  -m m,  --memory-limit=m" << std::endl
+		<< "\t\t\tkeep no more than m plans in memory with SMA* search"
+		<< std::endl
+		<< "  -P,    --parallel\t"
+		<< "search with each flaw order in its own thread" << std::endl
 		<< "  -r,    --random-open-conditions" << std::endl
 		<< "\t\t\tadd open conditions in random order"
 		<< std::endl
@@ -161,8 +181,8 @@ static void cleanup() {
 		<< std::endl
 		<< "Bindings created: " << created_bindings << std::endl
 		<< "Bindings deleted: " << deleted_bindings << std::endl
-		<< "Bool vectors created: " << created_bool_vectors << std::endl
-		<< "Bool vectors deleted: " << deleted_bool_vectors << std::endl
+		<< "Bit chunks created: " << created_bit_chunks << std::endl
+		<< "Bit chunks deleted: " << deleted_bit_chunks << std::endl
 		<< "Float vectors created: " << created_float_vectors << std::endl
 		<< "Float vectors deleted: " << deleted_float_vectors << std::endl
 		<< "Orderings created: " << created_orderings << std::endl
@@ -182,8 +202,8 @@ size_t created_action_domains = 0;
 size_t deleted_action_domains = 0;
 size_t created_bindings = 0;
 size_t deleted_bindings = 0;
-size_t created_bool_vectors = 0;
-size_t deleted_bool_vectors = 0;
+size_t created_bit_chunks = 0;
+size_t deleted_bit_chunks = 0;
 size_t created_float_vectors = 0;
 size_t deleted_float_vectors = 0;
 size_t created_orderings = 0;
@@ -232,6 +252,12 @@ int main(int argc, char* argv[]) {
 			params.domain_constraints = true;
 			params.keep_static_preconditions = (optarg == NULL || atoi(optarg) != 0);
 			break;
+		case 'D':
+			params.duplicate_detection = true;
+			break;
+		case 'e':
+			params.lazy_evaluation = true;
+			break;
 		case 'f':
 			try {
 				if (no_flaw_order) {
@@ -261,6 +287,9 @@ int main(int argc, char* argv[]) {
 				return -1;
 			}
 			break;
+		case 'j':
+			params.search_threads = std::max(1, atoi(optarg));
+			break;
 		case 'l':
 			if (no_search_limit) {
 				params.search_limits.clear();
@@ -273,6 +302,12 @@ int main(int argc, char* argv[]) {
 				params.search_limits.push_back(atoi(optarg));
 			}
 			break;
+		case 'm':
+			params.memory_limit = std::max(2, atoi(optarg));
+			break;
+		case 'P':
+			params.parallel_flaw_orders = true;
+			break;
 		case 'r':
 			params.random_open_conditions = true;
 			break;
@@ -384,9 +419,7 @@ int main(int argc, char* argv[]) {
 			pi++;
 			std::cout << ';' << problem.get_name() << std::endl;
 			// diff here
-			const Plan* plan =
-				Plan::plan(problem, params,
-					!ALWAYS_DELETE_ALL && pi == Problem::end());
+			const Plan* plan = Plan::plan(problem, params);
 			if (plan != NULL) {
 				if (plan->is_complete()) {
 					if (verbosity > 0) {